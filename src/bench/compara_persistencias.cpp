@@ -0,0 +1,443 @@
+// Compara a arvore persistente com formas ingenuas de persistir, reproduzindo o mesmo arquivo
+// de entrada (vide SPEC.md) em cada uma:
+//   copia_de_nohs:    abb com o motor padrao, por copia de nohs
+//   copia_de_caminho: abb com o motor por copia de caminho, de nohs imutaveis
+//   copia_integral:   uma copia inteira do conjunto (std::multiset, ja que a arvore aceita
+//                     chaves repetidas) a cada versao
+// Para cada uma, informa o tempo total, o pico de memoria do processo e a latencia das
+// consultas (SUC e IMP), alem de um resumo das respostas, que deve ser igual em todas. As
+// consultas sao respondidas sem formatar nem escrever a saida. Cada estrutura roda num
+// processo proprio, para que o pico de memoria seja so dela.
+//
+// Uso: ./compara_persistencias arquivo_entrada [--estrutura=nome] [--operacoes=N] [--limite-mb=N]
+// Sem --estrutura, roda todas. --operacoes reproduz so o inicio do arquivo, para ver como os
+// custos crescem com as versoes. A copia integral para ao passar de --limite-mb (4096 por
+// padrao) de memoria estimada.
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+#include "io/file_parser.h"
+#include "io/operacao.h"
+#include "persistencia/abb.h"
+#include "persistencia/copia_de_caminho.h"
+#include "persistencia/instrumentacao.h"
+
+namespace
+{
+
+using ufc::eda::io::op;
+using ufc::eda::persistencia::histograma;
+using relogio = std::chrono::steady_clock;
+
+const char* const estruturas[] = { "copia_de_nohs", "copia_de_caminho", "copia_integral" };
+
+// Pico de memoria residente do processo, em KB (0 onde nao ha como medir)
+size_t pico_rss_kb()
+{
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+#if defined(__APPLE__)
+    return static_cast<size_t>(uso.ru_maxrss) / 1024;
+#else
+    return static_cast<size_t>(uso.ru_maxrss);
+#endif
+#endif
+}
+
+// Resumo das respostas das consultas, na ordem: iguais nas estruturas se as respostas forem
+struct verificacao
+{
+    void soma(uint64_t valor)
+    {
+        resumo = (resumo ^ valor) * 0x100000001b3ull;
+    }
+
+    uint64_t resumo = 0xcbf29ce484222325ull;
+};
+
+// Arvore persistente rubro-negra, como no cli, com o motor indicado
+template <template <typename, typename> class motor>
+class arvore
+{
+public:
+    void inclui(int x)
+    {
+        _arvore.inclui(x);
+    }
+
+    void remove(int x)
+    {
+        _arvore.remove(x);
+    }
+
+    size_t ultima_versao() const
+    {
+        return _arvore.ultima_versao();
+    }
+
+    void sucessor(int x, size_t versao, verificacao& v) const
+    {
+        const int* s = _arvore.busca_sucessor(x, versao);
+        v.soma(s != nullptr ? static_cast<uint64_t>(*s) : UINT64_MAX);
+    }
+
+    void imprime(size_t versao, verificacao& v) const
+    {
+        versao = _arvore.versao_lida(versao);
+        _arvore.percorre_em_ordem(versao, [versao, &v](const noh& n, int) { v.soma(static_cast<uint64_t>(n.chave(versao))); });
+    }
+
+    bool excedeu(size_t) const
+    {
+        return false;
+    }
+
+private:
+    using abb = ufc::eda::persistencia::abb_persistente<motor>;
+    using noh = typename abb::noh;
+
+    abb _arvore { abb::balanceamento::rubro_negro };
+};
+
+// Cada versao eh uma copia inteira da anterior com a atualizacao aplicada
+class copia_integral
+{
+public:
+    copia_integral()
+    {
+        _versoes.emplace_back();
+    }
+
+    void inclui(int x)
+    {
+        _versoes.push_back(_versoes.back());
+        _versoes.back().insert(x);
+        _elementos += _versoes.back().size();
+    }
+
+    void remove(int x)
+    {
+        _versoes.push_back(_versoes.back());
+        std::multiset<int>& s = _versoes.back();
+        const std::multiset<int>::iterator i = s.find(x);
+        if (i != s.end())
+        {
+            s.erase(i);
+        }
+        _elementos += s.size();
+    }
+
+    size_t ultima_versao() const
+    {
+        return _versoes.size() - 1;
+    }
+
+    void sucessor(int x, size_t versao, verificacao& v) const
+    {
+        const std::multiset<int>& s = le(versao);
+        const std::multiset<int>::const_iterator i = s.upper_bound(x);
+        v.soma(i != s.end() ? static_cast<uint64_t>(*i) : UINT64_MAX);
+    }
+
+    void imprime(size_t versao, verificacao& v) const
+    {
+        for (int x : le(versao))
+        {
+            v.soma(static_cast<uint64_t>(x));
+        }
+    }
+
+    // Estimativa da memoria dos conjuntos: cada elemento eh um noh da arvore da biblioteca,
+    // com tres ponteiros, a cor e a chave
+    bool excedeu(size_t limite_mb) const
+    {
+        return _elementos * bytes_por_elemento > static_cast<uint64_t>(limite_mb) << 20;
+    }
+
+private:
+    constexpr static const uint64_t bytes_por_elemento = 48;
+
+    const std::multiset<int>& le(size_t versao) const
+    {
+        return _versoes[versao < _versoes.size() ? versao : _versoes.size() - 1];
+    }
+
+    std::deque<std::multiset<int>> _versoes;
+    uint64_t _elementos = 0;
+};
+
+struct latencias
+{
+    void registra(relogio::duration d)
+    {
+        const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        distribuicao.registra(ns);
+        soma_ns += ns;
+    }
+
+    // Limite superior da faixa do histograma que contem o percentil
+    uint64_t percentil(double p) const
+    {
+        const uint64_t total = distribuicao.total();
+        uint64_t acumulado = 0;
+        for (size_t i = 0; i < histograma::n_faixas; i++)
+        {
+            acumulado += distribuicao.contagem(i);
+            if (total > 0 && static_cast<double>(acumulado) >= p * static_cast<double>(total))
+            {
+                return histograma::inicio_da_faixa(i + 1);
+            }
+        }
+
+        return 0;
+    }
+
+    std::string resumo() const
+    {
+        const uint64_t n = distribuicao.total();
+        return std::to_string(n) + " consultas, media " + std::to_string(n > 0 ? soma_ns / n : 0) + " ns, p50 < " +
+               std::to_string(percentil(0.5)) + " ns, p99 < " + std::to_string(percentil(0.99)) + " ns";
+    }
+
+    histograma distribuicao;
+    uint64_t soma_ns = 0;
+};
+
+template <typename estrutura>
+int reproduz(const char* nome, const std::vector<op>& ops, size_t limite_mb)
+{
+    estrutura e;
+    verificacao v;
+    latencias sucessores;
+    latencias impressoes;
+
+    size_t executadas = 0;
+    bool interrompida = false;
+    const relogio::time_point inicio = relogio::now();
+    for (const op& operacao : ops)
+    {
+        if (operacao.tipoOperacao == op::tipo::INCLUSAO || operacao.tipoOperacao == op::tipo::REMOCAO)
+        {
+            if (e.excedeu(limite_mb))
+            {
+                interrompida = true;
+                break;
+            }
+
+            if (operacao.tipoOperacao == op::tipo::INCLUSAO)
+            {
+                e.inclui(operacao.lparam);
+            }
+            else
+            {
+                e.remove(operacao.lparam);
+            }
+        }
+        else
+        {
+            const relogio::time_point antes = relogio::now();
+            if (operacao.tipoOperacao == op::tipo::SUCESSAO)
+            {
+                e.sucessor(operacao.lparam, static_cast<size_t>(operacao.rparam), v);
+                sucessores.registra(relogio::now() - antes);
+            }
+            else
+            {
+                e.imprime(static_cast<size_t>(operacao.lparam), v);
+                impressoes.registra(relogio::now() - antes);
+            }
+        }
+        executadas++;
+    }
+    const double segundos = std::chrono::duration<double>(relogio::now() - inicio).count();
+
+    std::printf("%s\n", nome);
+    std::printf("  operacoes:   %zu de %zu%s\n", executadas, ops.size(), interrompida ? " (interrompida no limite de memoria)" : "");
+    std::printf("  versoes:     %zu\n", e.ultima_versao() + 1);
+    std::printf("  tempo:       %.3f s\n", segundos);
+    std::printf("  pico de rss: %.1f MB\n", static_cast<double>(pico_rss_kb()) / 1024.0);
+    std::printf("  SUC:         %s\n", sucessores.resumo().c_str());
+    std::printf("  IMP:         %s\n", impressoes.resumo().c_str());
+    std::printf("  verificacao: %016llx\n", static_cast<unsigned long long>(v.resumo));
+    std::fflush(stdout);
+
+    return 0;
+}
+
+// Le um inteiro sem sinal de ate 19 digitos, nao maior que maximo; so digitos, como nas
+// opcoes numericas da cli (vide io/arg_parser.h)
+bool le_inteiro(const char* valor, uint64_t maximo, size_t& lido)
+{
+    const std::string texto = valor;
+    if (texto.empty() || texto.size() > 19 || texto.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+
+    char* fim = nullptr;
+    const unsigned long long n = std::strtoull(valor, &fim, 10);
+    if (*fim != '\0' || n > maximo || n > SIZE_MAX)
+    {
+        return false;
+    }
+
+    lido = static_cast<size_t>(n);
+    return true;
+}
+
+// Roda a estrutura sobre as primeiras operacoes da entrada
+int compara(const std::string& entrada, const std::string& estrutura, size_t operacoes, size_t limite_mb)
+{
+    std::vector<op> ops;
+    ufc::eda::io::file_parser fparser(entrada, ufc::eda::io::file_parser::leitura::mapeada);
+    const bool lida = fparser.parse([&ops, operacoes](const op& operacao) {
+        if (ops.size() < operacoes)
+        {
+            ops.push_back(operacao);
+        }
+    });
+    if (!lida)
+    {
+        std::printf("[ERRO] Nao foi possivel ler %s\n", entrada.c_str());
+        return 2;
+    }
+
+    // O pico inclui as operacoes lidas, iguais para todas as estruturas
+    std::printf("[%s: %zu operacoes lidas, pico de rss %.1f MB antes de reproduzir]\n", entrada.c_str(), ops.size(),
+                static_cast<double>(pico_rss_kb()) / 1024.0);
+
+    if (estrutura == estruturas[0])
+    {
+        return reproduz<arvore<ufc::eda::persistencia::copia_de_nohs>>(estrutura.c_str(), ops, limite_mb);
+    }
+    if (estrutura == estruturas[1])
+    {
+        return reproduz<arvore<ufc::eda::persistencia::copia_de_caminho>>(estrutura.c_str(), ops, limite_mb);
+    }
+    if (estrutura == estruturas[2])
+    {
+        return reproduz<copia_integral>(estrutura.c_str(), ops, limite_mb);
+    }
+
+    std::printf("[ERRO] Estrutura desconhecida: %s\n", estrutura.c_str());
+    return 1;
+}
+
+#ifndef _WIN32
+// Roda este mesmo programa para uma estrutura, com os argumentos passados direto ao
+// processo, sem shell no meio. Retorna se ele terminou com sucesso
+bool compara_em_outro_processo(const char* programa, const std::string& entrada, const std::string& estrutura,
+                               const std::vector<std::string>& repassadas)
+{
+    std::vector<std::string> args = { programa, entrada, "--estrutura=" + estrutura };
+    args.insert(args.end(), repassadas.begin(), repassadas.end());
+
+    std::vector<char*> argv;
+    for (std::string& arg : args)
+    {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    pid_t filho;
+    if (posix_spawnp(&filho, programa, nullptr, nullptr, argv.data(), environ) != 0)
+    {
+        std::printf("[ERRO] Nao foi possivel executar %s\n", programa);
+        return false;
+    }
+
+    int status = 0;
+    while (waitpid(filho, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return false;
+        }
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::printf("USO: %s arquivo_entrada [--estrutura=copia_de_nohs|copia_de_caminho|copia_integral] "
+                    "[--operacoes=N] [--limite-mb=N]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string entrada = argv[1];
+    std::string estrutura;
+    std::vector<std::string> repassadas;
+    size_t operacoes = SIZE_MAX;
+    size_t limite_mb = 4096;
+    for (int i = 2; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 12, "--estrutura=") == 0)
+        {
+            estrutura = arg.substr(12);
+            continue;
+        }
+
+        // O limite, em bytes, ainda cabe em 64 bits
+        bool valida = false;
+        if (arg.compare(0, 12, "--operacoes=") == 0)
+        {
+            valida = le_inteiro(arg.c_str() + 12, UINT64_MAX, operacoes);
+        }
+        else if (arg.compare(0, 12, "--limite-mb=") == 0)
+        {
+            valida = le_inteiro(arg.c_str() + 12, UINT64_MAX >> 20, limite_mb);
+        }
+
+        if (!valida)
+        {
+            std::printf("[ERRO] Opcao invalida: %s\n", arg.c_str());
+            return 1;
+        }
+        repassadas.push_back(arg);
+    }
+
+    if (!estrutura.empty())
+    {
+        return compara(entrada, estrutura, operacoes, limite_mb);
+    }
+
+    int falhas = 0;
+    for (const char* nome : estruturas)
+    {
+#ifndef _WIN32
+        // Um processo por estrutura, cada um com o seu pico de memoria
+        falhas += compara_em_outro_processo(argv[0], entrada, nome, repassadas) ? 0 : 1;
+#else
+        // Sem posix_spawn, roda todas aqui; o pico de memoria nao eh medido mesmo (vide pico_rss_kb)
+        falhas += compara(entrada, nome, operacoes, limite_mb) == 0 ? 0 : 1;
+#endif
+    }
+
+    return falhas == 0 ? 0 : 2;
+}
@@ -0,0 +1,153 @@
+// Gera um arquivo de entrada sintetico para o cli (vide io/gerador_de_carga.h). A mesma
+// semente e os mesmos parametros geram sempre o mesmo arquivo.
+//
+// Uso: ./gera_carga arquivo_saida [--operacoes=N] [--semente=N] [--leituras=percentual]
+//      [--remocoes=percentual] [--impressao-a-cada=N] [--chaves=uniforme|zipf|monotonica|adversaria]
+//      [--intervalo=N] [--zipf=expoente] [--vies-das-versoes=vies]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "io/file_writer.h"
+#include "io/gerador_de_carga.h"
+
+namespace
+{
+
+const char* instrucoes =
+    "./gera_carga arquivo_saida [--operacoes=N] [--semente=N] [--leituras=percentual] [--remocoes=percentual] "
+    "[--impressao-a-cada=N] [--chaves=uniforme|zipf|monotonica|adversaria] [--intervalo=N] [--zipf=expoente] "
+    "[--vies-das-versoes=vies]";
+
+bool le_inteiro(const std::string& valor, uint64_t maximo, uint64_t& lido)
+{
+    if (valor.empty() || valor.size() > 19 || valor.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+
+    lido = std::strtoull(valor.c_str(), nullptr, 10);
+    return lido <= maximo;
+}
+
+bool le_real(const std::string& valor, double& lido)
+{
+    char* fim = nullptr;
+    lido = std::strtod(valor.c_str(), &fim);
+    return !valor.empty() && *fim == '\0' && lido >= 0.0;
+}
+
+// Le uma opcao --nome=valor nos parametros; retorna false se for desconhecida ou invalida
+bool le_opcao(const std::string& arg, uint64_t& operacoes, ufc::eda::io::gerador_de_carga::parametros& p)
+{
+    const size_t igual = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || igual == std::string::npos)
+    {
+        return false;
+    }
+
+    const std::string nome = arg.substr(2, igual - 2);
+    const std::string valor = arg.substr(igual + 1);
+
+    uint64_t n = 0;
+    if (nome == "operacoes")
+    {
+        // As versoes sao escritas como int
+        return le_inteiro(valor, static_cast<uint64_t>(std::numeric_limits<int>::max()), operacoes);
+    }
+    if (nome == "semente")
+    {
+        return le_inteiro(valor, std::numeric_limits<uint64_t>::max(), p.semente);
+    }
+    if (nome == "leituras" || nome == "remocoes")
+    {
+        if (!le_inteiro(valor, 100, n))
+        {
+            return false;
+        }
+        (nome == "leituras" ? p.percentual_de_leituras : p.percentual_de_remocoes) = static_cast<unsigned>(n);
+        return true;
+    }
+    if (nome == "impressao-a-cada")
+    {
+        return le_inteiro(valor, std::numeric_limits<uint64_t>::max(), p.impressao_a_cada);
+    }
+    if (nome == "chaves")
+    {
+        return ufc::eda::io::gerador_de_carga::le_distribuicao(valor, p.chaves);
+    }
+    if (nome == "intervalo")
+    {
+        // Chaves em [0, intervalo), todas representaveis como int
+        if (!le_inteiro(valor, static_cast<uint64_t>(std::numeric_limits<int>::max()) + 1, n) || n == 0)
+        {
+            return false;
+        }
+        p.intervalo = static_cast<uint32_t>(n);
+        return true;
+    }
+    if (nome == "zipf")
+    {
+        return le_real(valor, p.expoente_zipf);
+    }
+    if (nome == "vies-das-versoes")
+    {
+        return le_real(valor, p.vies_das_versoes);
+    }
+
+    return false;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t operacoes = 1000000;
+    ufc::eda::io::gerador_de_carga::parametros p;
+
+    std::string arquivo_saida;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0 && arquivo_saida.empty())
+        {
+            arquivo_saida = arg;
+        }
+        else if (!le_opcao(arg, operacoes, p))
+        {
+            std::printf("[ERRO] Opcao invalida: %s\n       USO: %s\n", arg.c_str(), instrucoes);
+            return 1;
+        }
+    }
+
+    if (arquivo_saida.empty())
+    {
+        std::printf("[ERRO] Falta o arquivo de saida!\n       USO: %s\n", instrucoes);
+        return 1;
+    }
+
+    ufc::eda::io::file_writer fwriter(arquivo_saida, ufc::eda::io::file_writer::saida::direta);
+    ufc::eda::io::gerador_de_carga gerador(p);
+
+    uint64_t por_tipo[4] = {};
+    for (uint64_t i = 0; i < operacoes; i++)
+    {
+        const ufc::eda::io::op operacao = gerador.proxima();
+        if (!fwriter.anexa(operacao))
+        {
+            std::printf("[ERRO] Nao foi possivel escrever em %s\n", arquivo_saida.c_str());
+            return 2;
+        }
+        por_tipo[static_cast<int>(operacao.tipoOperacao)]++;
+    }
+
+    std::printf("[OK] %llu operacoes: %llu INC, %llu REM, %llu SUC, %llu IMP; %llu versoes\n",
+                static_cast<unsigned long long>(operacoes), static_cast<unsigned long long>(por_tipo[0]),
+                static_cast<unsigned long long>(por_tipo[1]), static_cast<unsigned long long>(por_tipo[2]),
+                static_cast<unsigned long long>(por_tipo[3]), static_cast<unsigned long long>(gerador.versao() + 1));
+
+    return 0;
+}
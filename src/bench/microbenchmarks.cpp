@@ -0,0 +1,295 @@
+// Microbenchmarks da arvore persistente: cada caso mede uma operacao sobre uma arvore ja
+// montada e informa o tempo e as alocacoes de memoria por operacao. As arvores variam em
+// tamanho, em quantidade de versoes e na distribuicao das chaves.
+//
+// Uso: ./bench [filtro]
+// Com um filtro, so roda os casos cujo nome o contem (ex.: "sucessor").
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "io/utils.h"
+#include "persistencia/abb.h"
+
+namespace
+{
+    // Alocacoes feitas por operator new em todo o processo
+    std::atomic<uint64_t> alocacoes { 0 };
+    std::atomic<uint64_t> bytes_alocados { 0 };
+}
+
+void* operator new(size_t tamanho)
+{
+    alocacoes.fetch_add(1, std::memory_order_relaxed);
+    bytes_alocados.fetch_add(tamanho, std::memory_order_relaxed);
+
+    void* p = std::malloc(tamanho > 0 ? tamanho : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+
+using abb = ufc::eda::persistencia::abb;
+using relogio = std::chrono::steady_clock;
+
+enum class distribuicao { ordenada, aleatoria, repetida };
+
+const char* nome(distribuicao d)
+{
+    return d == distribuicao::ordenada ? "ordenada" : d == distribuicao::aleatoria ? "aleatoria" : "repetida";
+}
+
+struct parametros
+{
+    size_t tamanho;
+    size_t versoes;
+    distribuicao chaves;
+};
+
+// Gera as chaves da arvore: ordenada sao 0, 1, 2...; aleatoria, uniformes num intervalo bem
+// maior que o tamanho; repetida, poucas chaves distintas (1 a cada 100), cada uma muitas vezes
+class gerador_de_chaves
+{
+public:
+    gerador_de_chaves(distribuicao d, size_t tamanho) : _distribuicao(d), _tamanho(tamanho), _aleatorio(42) {}
+
+    int proxima()
+    {
+        switch (_distribuicao)
+        {
+        case distribuicao::ordenada:
+            return static_cast<int>(_sequencia++);
+        case distribuicao::aleatoria:
+            return static_cast<int>(_aleatorio() % (_tamanho * 16));
+        default:
+            return static_cast<int>(_aleatorio() % std::max<size_t>(_tamanho / 100, 1));
+        }
+    }
+
+    // Uma chave qualquer do intervalo das geradas, para consultas
+    int consulta()
+    {
+        const size_t intervalo = _distribuicao == distribuicao::aleatoria ? _tamanho * 16 :
+                                 _distribuicao == distribuicao::repetida ? std::max<size_t>(_tamanho / 100, 1) :
+                                 std::max<size_t>(_sequencia, 1);
+        return static_cast<int>(_aleatorio() % intervalo);
+    }
+
+    size_t sorteia(size_t n)
+    {
+        return static_cast<size_t>(_aleatorio() % n);
+    }
+
+private:
+    const distribuicao _distribuicao;
+    const size_t _tamanho;
+    std::mt19937_64 _aleatorio;
+    size_t _sequencia = 0;
+};
+
+// Arvore com `tamanho` chaves, seguida de atualizacoes que trocam uma chave presente por
+// uma nova, ate a arvore ter `versoes` versoes, sem mudar de tamanho
+struct arvore_montada
+{
+    explicit arvore_montada(const parametros& p) : chaves(p.chaves, p.tamanho)
+    {
+        presentes.reserve(p.tamanho);
+        for (size_t i = 0; i < p.tamanho; i++)
+        {
+            presentes.push_back(chaves.proxima());
+            arvore.inclui(presentes.back());
+        }
+
+        while (arvore.ultima_versao() + 2 <= p.versoes)
+        {
+            const size_t i = chaves.sorteia(presentes.size());
+            arvore.remove(presentes[i]);
+            presentes[i] = chaves.proxima();
+            arvore.inclui(presentes[i]);
+        }
+    }
+
+    gerador_de_chaves chaves;
+    std::vector<int> presentes;
+    abb arvore { abb::balanceamento::rubro_negro };
+};
+
+struct medida
+{
+    double ns_por_operacao;
+    double alocacoes_por_operacao;
+    double bytes_por_operacao;
+};
+
+// Roda o lote (que executa `operacoes_por_lote` operacoes) ate passar do tempo minimo, ou
+// uma vez so se o lote nao puder ser repetido
+medida mede(size_t operacoes_por_lote, bool repete, const std::function<void()>& lote)
+{
+    constexpr static const std::chrono::milliseconds tempo_minimo(200);
+
+    const uint64_t alocacoes_antes = alocacoes.load();
+    const uint64_t bytes_antes = bytes_alocados.load();
+    const relogio::time_point inicio = relogio::now();
+
+    size_t operacoes = 0;
+    do
+    {
+        lote();
+        operacoes += operacoes_por_lote;
+    } while (repete && relogio::now() - inicio < tempo_minimo);
+
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(relogio::now() - inicio).count());
+    const double n = static_cast<double>(std::max<size_t>(operacoes, 1));
+
+    return { ns / n, static_cast<double>(alocacoes.load() - alocacoes_antes) / n,
+             static_cast<double>(bytes_alocados.load() - bytes_antes) / n };
+}
+
+void relata(const char* caso, const parametros& p, const medida& m)
+{
+    std::printf("%-20s %10zu %10zu %-10s %12.1f %10.3f %12.1f\n", caso, p.tamanho, p.versoes, nome(p.chaves),
+                m.ns_por_operacao, m.alocacoes_por_operacao, m.bytes_por_operacao);
+    std::fflush(stdout);
+}
+
+// Impede que o compilador descarte o resultado das consultas
+volatile int64_t descarte = 0;
+
+void roda(const parametros& p, const std::string& filtro)
+{
+    auto ligado = [&filtro](const char* caso) { return filtro.empty() || std::string(caso).find(filtro) != std::string::npos; };
+
+    arvore_montada m(p);
+    abb& arvore = m.arvore;
+    const size_t ultima = arvore.ultima_versao();
+    constexpr static const size_t consultas_por_lote = 10000;
+
+    if (ligado("sucessor_ultima"))
+    {
+        relata("sucessor_ultima", p, mede(consultas_por_lote, true, [&m, &arvore, ultima]() {
+            int64_t soma = 0;
+            for (size_t i = 0; i < consultas_por_lote; i++)
+            {
+                const int* s = arvore.busca_sucessor(m.chaves.consulta(), ultima);
+                soma += s != nullptr ? *s : 0;
+            }
+            descarte = descarte + soma;
+        }));
+    }
+
+    if (ligado("sucessor_historica"))
+    {
+        relata("sucessor_historica", p, mede(consultas_por_lote, true, [&m, &arvore, ultima]() {
+            int64_t soma = 0;
+            for (size_t i = 0; i < consultas_por_lote; i++)
+            {
+                const int* s = arvore.busca_sucessor(m.chaves.consulta(), m.chaves.sorteia(ultima + 1));
+                soma += s != nullptr ? *s : 0;
+            }
+            descarte = descarte + soma;
+        }));
+    }
+
+    if (ligado("campos_do_noh"))
+    {
+        // Leitura dos campos de nohs e versoes sorteados, como numa descida em versao antiga
+        const size_t total = arvore.total_nohs();
+        relata("campos_do_noh", p, mede(consultas_por_lote, true, [&m, &arvore, total, ultima]() {
+            int64_t soma = 0;
+            for (size_t i = 0; i < consultas_por_lote; i++)
+            {
+                const abb::noh& n = arvore.obtem_noh(static_cast<abb::indice>(1 + m.chaves.sorteia(total - 1)));
+                const size_t v = m.chaves.sorteia(ultima + 1);
+                soma += n.chave(v) + n.esq(v) + n.dir(v) + static_cast<int>(n.cor(v));
+            }
+            descarte = descarte + soma;
+        }));
+    }
+
+    if (ligado("visita_em_ordem"))
+    {
+        relata("visita_em_ordem", p, mede(1, true, [&arvore, ultima]() {
+            int64_t soma = 0;
+            arvore.visita_em_ordem(ultima, [&soma, ultima](const abb::noh& n) { soma += n.chave(ultima); });
+            descarte = descarte + soma;
+        }));
+    }
+
+    if (ligado("to_string"))
+    {
+        relata("to_string", p, mede(1, true, [&arvore, ultima]() {
+            descarte = descarte + static_cast<int64_t>(ufc::eda::io::utils::to_string(arvore, ultima).size());
+        }));
+    }
+
+    // As atualizacoes mudam a arvore, entao rodam por ultimo e um lote so. As remocoes
+    // tiram chaves presentes; as inclusoes as repoem
+    const size_t atualizacoes = std::min<size_t>(consultas_por_lote, m.presentes.size());
+    if (ligado("remove"))
+    {
+        relata("remove", p, mede(atualizacoes, false, [&m, &arvore, atualizacoes]() {
+            for (size_t i = 0; i < atualizacoes; i++)
+            {
+                arvore.remove(m.presentes[i]);
+            }
+        }));
+    }
+
+    if (ligado("inclui"))
+    {
+        relata("inclui", p, mede(atualizacoes, false, [&m, &arvore, atualizacoes]() {
+            for (size_t i = 0; i < atualizacoes; i++)
+            {
+                arvore.inclui(m.presentes[i]);
+            }
+        }));
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const std::string filtro = argc > 1 ? argv[1] : "";
+
+    std::printf("motor: %s (rubro-negra)\n", abb::nome_do_motor());
+    std::printf("%-20s %10s %10s %-10s %12s %10s %12s\n", "caso", "tamanho", "versoes", "chaves", "ns/op", "alocs/op", "bytes/op");
+
+    for (size_t tamanho : { size_t(1000), size_t(100000) })
+    {
+        for (size_t versoes_por_chave : { size_t(1), size_t(10) })
+        {
+            for (distribuicao d : { distribuicao::ordenada, distribuicao::aleatoria, distribuicao::repetida })
+            {
+                roda({ tamanho, tamanho * versoes_por_chave, d }, filtro);
+            }
+        }
+    }
+
+    return 0;
+}
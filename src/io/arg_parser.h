@@ -21,9 +21,19 @@ public:
         NUMERO_DE_ARGUMENTOS_INVALIDO,
         ARQUIVO_ENTRADA_INVALIDO,
         ARQUIVO_SAIDA_INVALIDO,
-        AMBOS_ARQUIVOS_INVALIDOS
+        AMBOS_ARQUIVOS_INVALIDOS,
+        OPCAO_INVALIDA
     };
 
+    // Opcoes aceitas, na forma --nome=valor, em qualquer posicao apos o executavel
+    constexpr static const char* OPCAO_CARREGA_IMAGEM = "carrega-imagem";
+    constexpr static const char* OPCAO_SALVA_IMAGEM = "salva-imagem";
+    constexpr static const char* OPCAO_DIARIO = "diario";
+    constexpr static const char* OPCAO_SINCRONIZA_A_CADA = "sincroniza-a-cada";
+    constexpr static const char* OPCAO_RETEM_VERSOES = "retem-versoes";
+    constexpr static const char* OPCAO_CUSTOS = "custos";
+    constexpr static const char* OPCAO_ESTATISTICAS = "estatisticas";
+
     arg_parser() = default;
 
     void adiciona(const std::string& arg)
@@ -61,6 +71,23 @@ public:
         return checked_arg(2);
     }
 
+    // Valor da opcao, ou vazio se ela nao foi passada
+    const std::string& opcao(const std::string& nome) const
+    {
+        if (_status == status::SUCESSO)
+        {
+            for (const auto& o : opcoes)
+            {
+                if (o.nome == nome)
+                {
+                    return o.valor;
+                }
+            }
+        }
+
+        return sentinela;
+    }
+
 private:
     struct nome_arquivo_separado
     {
@@ -68,9 +95,19 @@ private:
         std::string extensao;
     };
 
+    struct opcao_nomeada
+    {
+        std::string nome;
+        std::string valor;
+    };
+
     void valida()
     {
-        if (args.size() != 3)
+        if (!separa_opcoes())
+        {
+            _status = status::OPCAO_INVALIDA;
+        }
+        else if (args.size() != 3)
         {
             _status = status::NUMERO_DE_ARGUMENTOS_INVALIDO;
         }
@@ -103,6 +140,64 @@ private:
         }
     }
 
+    // Tira de args as opcoes; falha com uma opcao desconhecida, repetida ou sem valor
+    bool separa_opcoes()
+    {
+        std::vector<std::string> posicionais;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            const std::string& arg = args[i];
+            if (i == 0 || arg.compare(0, 2, "--") != 0)
+            {
+                posicionais.push_back(arg);
+                continue;
+            }
+
+            const size_t igual = arg.find('=');
+            if (igual == std::string::npos || igual + 1 == arg.size())
+            {
+                return false;
+            }
+
+            opcao_nomeada o { arg.substr(2, igual - 2), arg.substr(igual + 1) };
+            if (!opcao_valida(o) || ja_tem_opcao(o.nome))
+            {
+                return false;
+            }
+
+            opcoes.push_back(o);
+        }
+
+        args.swap(posicionais);
+
+        return true;
+    }
+
+    static bool opcao_valida(const opcao_nomeada& o)
+    {
+        if (o.nome == OPCAO_SINCRONIZA_A_CADA || o.nome == OPCAO_RETEM_VERSOES)
+        {
+            // Quantidade de operacoes ou de versoes, com folga para caber em qualquer size_t
+            return o.valor.size() <= 9 && o.valor.find_first_not_of("0123456789") == std::string::npos;
+        }
+
+        return o.nome == OPCAO_CARREGA_IMAGEM || o.nome == OPCAO_SALVA_IMAGEM || o.nome == OPCAO_DIARIO ||
+               o.nome == OPCAO_CUSTOS || o.nome == OPCAO_ESTATISTICAS;
+    }
+
+    bool ja_tem_opcao(const std::string& nome) const
+    {
+        for (const auto& o : opcoes)
+        {
+            if (o.nome == nome)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     std::string nome_arquivo_validado(const std::string& arg) const
     {
         auto nome_separado = separa_nome_arquivo(arg);
@@ -153,6 +248,7 @@ private:
 
     const std::string sentinela = "";
     std::vector<std::string> args;
+    std::vector<opcao_nomeada> opcoes;
     status _status = status::INDEFINIDO;
 };
 
@@ -0,0 +1,192 @@
+#ifndef ARQUIVO_DURAVEL_H_
+#define ARQUIVO_DURAVEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Arquivo binario escrito sempre ao final, direto pelo descritor e sem buffer proprio, com
+// sincronizacao explicita com o disco. Para dados que precisam sobreviver a uma queda do
+// processo ou da maquina: so o que foi escrito antes de um sincroniza() bem sucedido esta
+// garantido no disco
+class arquivo_duravel
+{
+public:
+    // cria_vazio descarta o conteudo de um arquivo existente; preserva o mantem
+    enum class abertura { cria_vazio, preserva };
+
+    arquivo_duravel(const std::string& nome_arquivo, abertura modo)
+    {
+#ifdef _WIN32
+        int flags = _O_RDWR | _O_CREAT | _O_APPEND | _O_BINARY;
+        if (modo == abertura::cria_vazio)
+        {
+            flags |= _O_TRUNC;
+        }
+        if (_sopen_s(&_descritor, nome_arquivo.c_str(), flags, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+        {
+            _descritor = -1;
+        }
+#else
+        int flags = O_RDWR | O_CREAT | O_APPEND;
+        if (modo == abertura::cria_vazio)
+        {
+            flags |= O_TRUNC;
+        }
+        _descritor = ::open(nome_arquivo.c_str(), flags, 0644);
+#endif
+    }
+
+    arquivo_duravel(const arquivo_duravel&) = delete;
+    arquivo_duravel& operator=(const arquivo_duravel&) = delete;
+
+    ~arquivo_duravel()
+    {
+        fecha();
+    }
+
+    bool aberto() const
+    {
+        return _descritor >= 0;
+    }
+
+    uint64_t tamanho() const
+    {
+        if (!aberto())
+        {
+            return 0;
+        }
+
+#ifdef _WIN32
+        const __int64 t = _filelengthi64(_descritor);
+        return t > 0 ? static_cast<uint64_t>(t) : 0;
+#else
+        struct stat info;
+        return ::fstat(_descritor, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+#endif
+    }
+
+    // Anexa os bytes ao final do arquivo, repetindo as escritas parciais
+    bool escreve(const void* dados, size_t tamanho)
+    {
+        const char* p = static_cast<const char*>(dados);
+        while (aberto() && tamanho > 0)
+        {
+#ifdef _WIN32
+            const unsigned int parte = tamanho > (1u << 30) ? (1u << 30) : static_cast<unsigned int>(tamanho);
+            const int escritos = _write(_descritor, p, parte);
+#else
+            const ssize_t escritos = ::write(_descritor, p, tamanho);
+            if (escritos < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            if (escritos <= 0)
+            {
+                return false;
+            }
+
+            p += escritos;
+            tamanho -= static_cast<size_t>(escritos);
+        }
+
+        return aberto();
+    }
+
+    // Descarta o que estiver apos os primeiros bytes do arquivo
+    bool trunca(uint64_t tamanho)
+    {
+#ifdef _WIN32
+        return aberto() && _chsize_s(_descritor, static_cast<__int64>(tamanho)) == 0;
+#else
+        return aberto() && ::ftruncate(_descritor, static_cast<off_t>(tamanho)) == 0;
+#endif
+    }
+
+    // Retorna quando tudo o que foi escrito estiver no disco
+    bool sincroniza()
+    {
+        if (!aberto())
+        {
+            return false;
+        }
+
+#if defined(_WIN32)
+        return _commit(_descritor) == 0;
+#elif defined(__linux__)
+        return ::fdatasync(_descritor) == 0;
+#else
+        return ::fsync(_descritor) == 0;
+#endif
+    }
+
+    bool fecha()
+    {
+        if (!aberto())
+        {
+            return true;
+        }
+
+#ifdef _WIN32
+        const bool sucesso = _close(_descritor) == 0;
+#else
+        const bool sucesso = ::close(_descritor) == 0;
+#endif
+        _descritor = -1;
+
+        return sucesso;
+    }
+
+    // Sincroniza o diretorio do arquivo, para que uma criacao ou renomeacao recente
+    // tambem sobreviva a uma queda. No Windows, nao ha o que fazer
+    static bool sincroniza_diretorio(const std::string& nome_arquivo)
+    {
+#ifdef _WIN32
+        (void)nome_arquivo;
+        return true;
+#else
+        const size_t barra = nome_arquivo.find_last_of('/');
+        const std::string diretorio = barra == std::string::npos ? "." : barra == 0 ? "/" : nome_arquivo.substr(0, barra);
+
+        const int descritor = ::open(diretorio.c_str(), O_RDONLY);
+        if (descritor < 0)
+        {
+            return false;
+        }
+
+        const bool sucesso = ::fsync(descritor) == 0;
+        ::close(descritor);
+
+        return sucesso;
+#endif
+    }
+
+private:
+    int _descritor = -1;
+};
+
+}
+}
+}
+
+#endif // ARQUIVO_DURAVEL_H_
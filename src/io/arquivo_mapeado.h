@@ -0,0 +1,225 @@
+#ifndef ARQUIVO_MAPEADO_H_
+#define ARQUIVO_MAPEADO_H_
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Arquivo mapeado em memoria: o conteudo eh lido direto das paginas do sistema, sem
+// copias para buffers intermediarios
+class arquivo_mapeado
+{
+public:
+    // leitura mapeia somente para leitura, para percorrer o arquivo do inicio ao fim.
+    // copia_na_escrita permite escrever no mapeamento: cada pagina escrita vira uma
+    // copia privada do processo, e o arquivo nunca eh alterado
+    enum class acesso { leitura, copia_na_escrita };
+
+    arquivo_mapeado(const std::string& nome_arquivo, acesso modo = acesso::leitura) : _modo(modo)
+    {
+        abre(nome_arquivo);
+    }
+
+    arquivo_mapeado(const arquivo_mapeado&) = delete;
+    arquivo_mapeado& operator=(const arquivo_mapeado&) = delete;
+
+    ~arquivo_mapeado()
+    {
+        fecha();
+    }
+
+    bool aberto() const
+    {
+        return _aberto;
+    }
+
+    const char* inicio() const
+    {
+        return _dados;
+    }
+
+    // So no acesso copia_na_escrita
+    char* inicio_gravavel()
+    {
+        return _modo == acesso::copia_na_escrita ? const_cast<char*>(_dados) : nullptr;
+    }
+
+    const char* fim() const
+    {
+        return _dados + _tamanho;
+    }
+
+    size_t tamanho() const
+    {
+        return _tamanho;
+    }
+
+    // Avisa que o trecho [inicio(), ate) nao sera mais lido, liberando suas paginas da
+    // memoria do processo. Para leituras em fluxo de arquivos maiores que a memoria
+    void descarta(const char* ate)
+    {
+#ifdef _WIN32
+        // Paginas de um mapeamento somente leitura sao devolvidas pelo sistema quando
+        // preciso; nao ha equivalente direto ao MADV_DONTNEED
+        (void)ate;
+#else
+        const size_t pagina = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t bytes = static_cast<size_t>(ate - _dados) / pagina * pagina;
+        if (_dados != nullptr && bytes > _descartados)
+        {
+            ::madvise(const_cast<char*>(_dados) + _descartados, bytes - _descartados, MADV_DONTNEED);
+            _descartados = bytes;
+        }
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    void abre(const std::string& nome_arquivo)
+    {
+        _arquivo = CreateFileA(nome_arquivo.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (_arquivo == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+
+        LARGE_INTEGER tamanho;
+        if (!GetFileSizeEx(_arquivo, &tamanho))
+        {
+            return;
+        }
+
+        _tamanho = static_cast<size_t>(tamanho.QuadPart);
+        _aberto = true;
+
+        // Arquivos vazios nao podem ser mapeados, mas sao validos
+        if (_tamanho == 0)
+        {
+            return;
+        }
+
+        const bool copia = _modo == acesso::copia_na_escrita;
+        _mapeamento = CreateFileMappingA(_arquivo, nullptr, copia ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+        if (_mapeamento != nullptr)
+        {
+            _dados = static_cast<const char*>(MapViewOfFile(_mapeamento, copia ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+        }
+
+        if (_dados == nullptr)
+        {
+            _tamanho = 0;
+            _aberto = false;
+        }
+    }
+
+    void fecha()
+    {
+        if (_dados != nullptr)
+        {
+            UnmapViewOfFile(_dados);
+        }
+
+        if (_mapeamento != nullptr)
+        {
+            CloseHandle(_mapeamento);
+        }
+
+        if (_arquivo != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(_arquivo);
+        }
+    }
+
+    HANDLE _arquivo = INVALID_HANDLE_VALUE;
+    HANDLE _mapeamento = nullptr;
+#else
+    void abre(const std::string& nome_arquivo)
+    {
+        _descritor = ::open(nome_arquivo.c_str(), O_RDONLY);
+        if (_descritor < 0)
+        {
+            return;
+        }
+
+        struct stat info;
+        if (::fstat(_descritor, &info) != 0)
+        {
+            return;
+        }
+
+        _tamanho = static_cast<size_t>(info.st_size);
+        _aberto = true;
+
+        // Arquivos vazios nao podem ser mapeados, mas sao validos
+        if (_tamanho == 0)
+        {
+            return;
+        }
+
+        const int protecao = _modo == acesso::copia_na_escrita ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* dados = ::mmap(nullptr, _tamanho, protecao, MAP_PRIVATE, _descritor, 0);
+        if (dados == MAP_FAILED)
+        {
+            _tamanho = 0;
+            _aberto = false;
+            return;
+        }
+
+        // A leitura eh sequencial, do inicio ao fim: o kernel pode ler adiante com folga
+        if (_modo == acesso::leitura)
+        {
+            ::madvise(dados, _tamanho, MADV_SEQUENTIAL);
+        }
+        _dados = static_cast<const char*>(dados);
+    }
+
+    void fecha()
+    {
+        if (_dados != nullptr)
+        {
+            ::munmap(const_cast<char*>(_dados), _tamanho);
+        }
+
+        if (_descritor >= 0)
+        {
+            ::close(_descritor);
+        }
+    }
+
+    int _descritor = -1;
+    size_t _descartados = 0;
+#endif
+
+    const acesso _modo;
+    const char* _dados = nullptr;
+    size_t _tamanho = 0;
+    bool _aberto = false;
+};
+
+}
+}
+}
+
+#endif // ARQUIVO_MAPEADO_H_
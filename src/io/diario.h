@@ -0,0 +1,298 @@
+#ifndef DIARIO_H_
+#define DIARIO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arquivo_duravel.h"
+#include "arquivo_mapeado.h"
+#include "operacao.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Diario (write-ahead log) das atualizacoes da arvore: cada inclusao ou remocao eh anexada
+// como um registro antes de ser aplicada. Cada registro cria exatamente uma versao, entao o
+// registro i do diario leva a arvore da versao versao_base() + i para a seguinte, e uma
+// arvore na versao v (vazia, ou carregada de uma imagem) se recupera reaplicando so os
+// registros a partir de v.
+//
+// Para nao pagar uma sincronizacao com o disco por operacao, os registros sao acumulados e
+// sincronizados em grupo, a cada operacoes_por_sincronizacao. Uma queda pode perder apenas
+// o grupo em andamento; o final incompleto de um registro interrompido eh descartado na
+// proxima abertura. Registros completos sao confiados, sem verificacao de conteudo.
+//
+// Formato (inteiros na ordem de bytes da maquina que gravou, conferida na abertura):
+//   cabecalho, em 0
+//   registros de 5 bytes: tipo ('I' ou 'R') e chave
+class diario
+{
+public:
+    constexpr static const size_t operacoes_por_sincronizacao_padrao = 1024;
+
+    // Abre o diario para continuar a anexar. Um arquivo inexistente, vazio ou menor que o
+    // cabecalho (criacao interrompida) eh criado comecando em versao_atual. Falha se o
+    // arquivo existir e nao for um diario
+    diario(const std::string& nome_arquivo, size_t versao_atual,
+           size_t operacoes_por_sincronizacao = operacoes_por_sincronizacao_padrao)
+        : _nome_arquivo(nome_arquivo), _operacoes_por_sincronizacao(operacoes_por_sincronizacao)
+    {
+        _buffer.reserve(capacidade_buffer);
+
+        bool novo = true;
+        {
+            arquivo_mapeado existente(nome_arquivo);
+            if (existente.aberto() && existente.tamanho() >= sizeof(cabecalho))
+            {
+                cabecalho c;
+                std::memcpy(&c, existente.inicio(), sizeof(c));
+                if (std::memcmp(c.assinatura, assinatura(), sizeof(c.assinatura)) != 0 ||
+                    c.versao_formato != versao_formato || c.ordem_bytes != ordem_bytes)
+                {
+                    return;
+                }
+
+                novo = false;
+                _versao_base = static_cast<size_t>(c.versao_base);
+                _registros = conta_registros(existente.inicio() + sizeof(c), existente.fim());
+            }
+        }
+
+        _arquivo.reset(new arquivo_duravel(
+            nome_arquivo, novo ? arquivo_duravel::abertura::cria_vazio : arquivo_duravel::abertura::preserva));
+        if (!_arquivo->aberto())
+        {
+            _arquivo.reset();
+            return;
+        }
+
+        if (novo)
+        {
+            if (!inicia(versao_atual) || !arquivo_duravel::sincroniza_diretorio(nome_arquivo))
+            {
+                _arquivo.reset();
+            }
+        }
+        else if (_arquivo->tamanho() > tamanho_valido())
+        {
+            // Sobra de um registro interrompido: os proximos sao anexados no lugar dela
+            if (!_arquivo->trunca(tamanho_valido()) || !_arquivo->sincroniza())
+            {
+                _arquivo.reset();
+            }
+        }
+    }
+
+    diario(const diario&) = delete;
+    diario& operator=(const diario&) = delete;
+
+    ~diario()
+    {
+        sincroniza();
+    }
+
+    bool aberto() const
+    {
+        return _arquivo != nullptr;
+    }
+
+    // Versao da arvore antes do primeiro registro
+    size_t versao_base() const
+    {
+        return _versao_base;
+    }
+
+    // Versao da arvore apos o ultimo registro, inclusive os ainda nao sincronizados
+    size_t versao_final() const
+    {
+        return _versao_base + _registros;
+    }
+
+    // Entrega ao consumidor, em ordem, as operacoes que levam a arvore da versao indicada
+    // ate versao_final(). Retorna false se a versao estiver fora do diario
+    template <typename consumidor>
+    bool reproduz(size_t versao, consumidor&& consome)
+    {
+        if (!aberto() || versao < _versao_base || versao > versao_final() || !descarrega())
+        {
+            return false;
+        }
+
+        if (versao == versao_final())
+        {
+            return true;
+        }
+
+        arquivo_mapeado mapa(_nome_arquivo);
+        if (!mapa.aberto() || mapa.tamanho() < tamanho_valido())
+        {
+            return false;
+        }
+
+        const char* p = mapa.inicio() + sizeof(cabecalho) + (versao - _versao_base) * tamanho_registro;
+        for (const char* fim = mapa.inicio() + tamanho_valido(); p != fim; p += tamanho_registro)
+        {
+            int chave;
+            std::memcpy(&chave, p + 1, sizeof(chave));
+            consome(op(p[0] == registro_inclusao ? op::tipo::INCLUSAO : op::tipo::REMOCAO, chave));
+        }
+
+        return true;
+    }
+
+    // Registra uma inclusao ou remocao; consultas sao ignoradas
+    void anexa(const op& operacao)
+    {
+        if (!aberto() || (operacao.tipoOperacao != op::tipo::INCLUSAO && operacao.tipoOperacao != op::tipo::REMOCAO))
+        {
+            return;
+        }
+
+        if (_buffer.size() + tamanho_registro > capacidade_buffer)
+        {
+            descarrega();
+        }
+
+        const char tipo = operacao.tipoOperacao == op::tipo::INCLUSAO ? registro_inclusao : registro_remocao;
+        const int32_t chave = operacao.lparam;
+        _buffer.push_back(tipo);
+        _buffer.insert(_buffer.end(), reinterpret_cast<const char*>(&chave), reinterpret_cast<const char*>(&chave) + sizeof(chave));
+        _registros++;
+
+        if (_operacoes_por_sincronizacao > 0 && ++_nao_sincronizados >= _operacoes_por_sincronizacao)
+        {
+            sincroniza();
+        }
+    }
+
+    // Escreve o que estiver acumulado e so retorna quando estiver no disco. Retorna false
+    // se alguma escrita desde a abertura falhou
+    bool sincroniza()
+    {
+        if (!aberto())
+        {
+            return false;
+        }
+
+        if (descarrega() && _nao_sincronizados > 0)
+        {
+            _falhou = !_arquivo->sincroniza() || _falhou;
+        }
+        _nao_sincronizados = 0;
+
+        return !_falhou;
+    }
+
+    // Esvazia o diario, que passa a comecar em versao_base. Para quando as versoes
+    // registradas ja estiverem guardadas em outro lugar, como numa imagem
+    bool reinicia(size_t versao_base)
+    {
+        if (!aberto())
+        {
+            return false;
+        }
+
+        _buffer.clear();
+        _registros = 0;
+        _nao_sincronizados = 0;
+
+        return _arquivo->trunca(0) && inicia(versao_base);
+    }
+
+private:
+    struct cabecalho
+    {
+        char assinatura[8];
+        uint32_t versao_formato;
+        uint32_t ordem_bytes;
+        uint64_t versao_base;
+    };
+
+    // Os 8 bytes, com o terminador, iniciam o arquivo
+    static const char* assinatura()
+    {
+        return "ABBDIAR";
+    }
+
+    constexpr static const uint32_t versao_formato = 1;
+    constexpr static const uint32_t ordem_bytes = 0x01020304;
+
+    constexpr static const char registro_inclusao = 'I';
+    constexpr static const char registro_remocao = 'R';
+    constexpr static const size_t tamanho_registro = 1 + sizeof(int32_t);
+
+    constexpr static const size_t capacidade_buffer = size_t(64) << 10;
+
+    // Registros completos a partir de inicio; para no primeiro tipo invalido (por exemplo,
+    // zeros deixados pelo sistema de arquivos apos uma queda) ou no final incompleto
+    static size_t conta_registros(const char* inicio, const char* fim)
+    {
+        size_t registros = 0;
+        for (const char* p = inicio; static_cast<size_t>(fim - p) >= tamanho_registro; p += tamanho_registro)
+        {
+            if (p[0] != registro_inclusao && p[0] != registro_remocao)
+            {
+                break;
+            }
+            registros++;
+        }
+
+        return registros;
+    }
+
+    uint64_t tamanho_valido() const
+    {
+        return sizeof(cabecalho) + static_cast<uint64_t>(_registros) * tamanho_registro;
+    }
+
+    // Escreve o cabecalho de um diario vazio e o leva ao disco
+    bool inicia(size_t versao_base)
+    {
+        cabecalho c;
+        std::memset(&c, 0, sizeof(c));
+        std::memcpy(c.assinatura, assinatura(), sizeof(c.assinatura));
+        c.versao_formato = versao_formato;
+        c.ordem_bytes = ordem_bytes;
+        c.versao_base = versao_base;
+
+        _versao_base = versao_base;
+        _falhou = !_arquivo->escreve(&c, sizeof(c)) || !_arquivo->sincroniza();
+
+        return !_falhou;
+    }
+
+    bool descarrega()
+    {
+        if (!_buffer.empty())
+        {
+            _falhou = !_arquivo->escreve(_buffer.data(), _buffer.size()) || _falhou;
+            _buffer.clear();
+        }
+
+        return !_falhou;
+    }
+
+    const std::string _nome_arquivo;
+    const size_t _operacoes_por_sincronizacao;
+    std::unique_ptr<arquivo_duravel> _arquivo;
+    std::vector<char> _buffer;
+
+    size_t _versao_base = 0;
+    size_t _registros = 0;
+    size_t _nao_sincronizados = 0;
+    bool _falhou = false;
+};
+
+}
+}
+}
+
+#endif // DIARIO_H_
@@ -0,0 +1,149 @@
+#ifndef ESTATISTICAS_H_
+#define ESTATISTICAS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "io/operacao.h"
+#include "io/utils.h"
+#include "persistencia/instrumentacao.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Estatisticas de uma execucao: a distribuicao das latencias de cada tipo de operacao, os
+// bytes escritos por cada IMP e quantas operacoes foram concluidas em cada janela de tempo.
+// As latencias e os bytes podem ser registrados por qualquer thread (os histogramas sao
+// contadores atomicos); as janelas, so pela thread que conduz a execucao. Os instantes vem
+// de um relogio monotonico, lido apenas com as estatisticas ligadas
+class estatisticas
+{
+public:
+    using relogio = std::chrono::steady_clock;
+
+    constexpr static const size_t n_tipos = 4;
+
+    explicit estatisticas(std::chrono::milliseconds janela = std::chrono::milliseconds(1000))
+        : _janela(janela), _inicio(relogio::now())
+    {
+    }
+
+    static relogio::time_point agora()
+    {
+        return relogio::now();
+    }
+
+    // Registra a latencia de uma operacao iniciada em inicio e concluida em fim
+    void registra(op::tipo tipo, relogio::time_point inicio, relogio::time_point fim)
+    {
+        const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(fim - inicio).count());
+
+        latencias& l = _latencias[static_cast<size_t>(tipo)];
+        l.distribuicao.registra(ns);
+        l.soma_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // Bytes da saida de uma IMP, inclusive a linha que ecoa a consulta
+    void registra_impressao(uint64_t bytes)
+    {
+        _bytes_por_impressao.registra(bytes);
+        _bytes_de_impressao.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Conta operacoes concluidas na janela do instante indicado
+    void conclui(size_t operacoes, relogio::time_point quando)
+    {
+        const size_t j = static_cast<size_t>((quando - _inicio) / relogio::duration(_janela));
+        if (j >= _por_janela.size())
+        {
+            _por_janela.resize(j + 1, 0);
+        }
+        _por_janela[j] += operacoes;
+    }
+
+    uint64_t quantidade(op::tipo tipo) const
+    {
+        return _latencias[static_cast<size_t>(tipo)].distribuicao.total();
+    }
+
+    const ufc::eda::persistencia::histograma& latencias_ns(op::tipo tipo) const
+    {
+        return _latencias[static_cast<size_t>(tipo)].distribuicao;
+    }
+
+    uint64_t bytes_de_impressao() const
+    {
+        return _bytes_de_impressao.load(std::memory_order_relaxed);
+    }
+
+    // Operacoes concluidas em cada janela, da primeira ate a ultima com alguma
+    const std::vector<uint64_t>& operacoes_por_janela() const
+    {
+        return _por_janela;
+    }
+
+    // Um objeto JSON com as latencias por tipo (histograma em faixas de potencias de 2 de
+    // nanossegundos, com o inicio de cada faixa), os bytes das IMPs e a vazao por janela
+    std::string em_json() const
+    {
+        static const char* const nomes[n_tipos] = { "INC", "REM", "SUC", "IMP" };
+
+        const double duracao = std::chrono::duration<double>(relogio::now() - _inicio).count();
+
+        std::string json = "{\n";
+        json += "  \"duracao_s\": " + std::to_string(duracao) + ",\n";
+        json += "  \"operacoes\": {";
+        for (size_t i = 0; i < n_tipos; i++)
+        {
+            const latencias& l = _latencias[i];
+            const uint64_t n = l.distribuicao.total();
+            const uint64_t soma = l.soma_ns.load(std::memory_order_relaxed);
+
+            json += i == 0 ? "\n" : ",\n";
+            json += "    \"" + std::string(nomes[i]) + "\": { \"quantidade\": " + std::to_string(n) +
+                    ", \"latencia_media_ns\": " + std::to_string(n > 0 ? soma / n : 0) +
+                    ", \"latencia_ns\": " + utils::detalhe::histograma_em_json(l.distribuicao) + " }";
+        }
+        json += "\n  },\n";
+        json += "  \"impressao\": { \"bytes\": " + std::to_string(bytes_de_impressao()) +
+                ", \"bytes_por_impressao\": " + utils::detalhe::histograma_em_json(_bytes_por_impressao) + " },\n";
+        json += "  \"janela_ms\": " + std::to_string(_janela.count()) + ",\n";
+        json += "  \"operacoes_por_janela\": [";
+        for (size_t j = 0; j < _por_janela.size(); j++)
+        {
+            json += (j == 0 ? "" : ", ") + std::to_string(_por_janela[j]);
+        }
+
+        return json + "]\n}\n";
+    }
+
+private:
+    struct latencias
+    {
+        ufc::eda::persistencia::histograma distribuicao;
+        std::atomic<uint64_t> soma_ns { 0 };
+    };
+
+    const std::chrono::milliseconds _janela;
+    const relogio::time_point _inicio;
+
+    std::array<latencias, n_tipos> _latencias;
+    ufc::eda::persistencia::histograma _bytes_por_impressao;
+    std::atomic<uint64_t> _bytes_de_impressao { 0 };
+    std::vector<uint64_t> _por_janela;
+};
+
+}
+}
+}
+
+#endif // ESTATISTICAS_H_
@@ -1,14 +1,30 @@
 #ifndef EXECUTOR_H_
 #define EXECUTOR_H_
 
+#include <chrono>
+#include <fstream>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "io/diario.h"
+#include "io/estatisticas.h"
+#include "io/fila_spsc.h"
+#include "io/imagem.h"
+#include "io/file_parser.h"
 #include "io/file_writer.h"
+#include "io/pool_de_threads.h"
 #include "io/operacao.h"
 #include "io/utils.h"
 #include "persistencia/abb.h"
 
+// Motor de persistencia da arvore do executor (vide abb.h). Definido pelo CMake
+#ifndef MOTOR_PERSISTENCIA
+#define MOTOR_PERSISTENCIA copia_de_nohs
+#endif
+
 namespace ufc
 {
 namespace eda
@@ -19,27 +35,418 @@ namespace io
 class executor
 {
 public:
-    executor(const std::string& arquivo_saida)
-        : arquivo_saida(arquivo_saida) {}
+    // Respostas das consultas de um trecho de operacoes, ainda sem formatar. Cada consulta
+    // guarda onde terminam seus dados: SUC guarda o sucessor, se houver; IMP guarda chave,
+    // profundidade e cor de cada noh, em ordem
+    struct respostas
+    {
+        struct resposta
+        {
+            op consulta;
+            size_t fim_dados;
+        };
+
+        bool vazia() const
+        {
+            return consultas.empty();
+        }
+
+        void anexa(const respostas& outras)
+        {
+            const size_t deslocamento = dados.size();
+            dados.insert(dados.end(), outras.dados.begin(), outras.dados.end());
+            for (const resposta& r : outras.consultas)
+            {
+                consultas.push_back({ r.consulta, r.fim_dados + deslocamento });
+            }
+        }
+
+        std::vector<resposta> consultas;
+        std::vector<int> dados;
+    };
+
+    // Operacoes lidas, aplicadas ou escritas de uma vez entre os estagios do pipeline
+    constexpr static const size_t operacoes_por_lote = 4096;
+
+    // Lotes em transito entre dois estagios, no maximo
+    constexpr static const size_t lotes_em_transito = 64;
+
+    // Consultas seguidas guardadas na execucao em fluxo antes de serem respondidas juntas
+    constexpr static const size_t consultas_por_rodada = 16384;
+
+    // threads eh quantas respondem em paralelo as consultas entre duas atualizacoes; com
+    // uma so, tudo eh executado nesta thread
+    executor(const std::string& arquivo_saida, size_t threads = threads_disponiveis())
+        : arquivo_saida(arquivo_saida)
+    {
+        if (threads > 1)
+        {
+            _pool.reset(new pool_de_threads(threads));
+        }
+    }
+
+    static size_t threads_disponiveis()
+    {
+        const size_t threads = std::thread::hardware_concurrency();
+        return threads > 0 ? threads : 1;
+    }
+
+    // Parte das versoes gravadas numa imagem, em vez de uma arvore vazia. So pode ser
+    // chamada antes de qualquer atualizacao; retorna false se a imagem nao servir
+    bool carrega_imagem(const std::string& arquivo_imagem)
+    {
+        return ufc::eda::io::carrega_imagem(arvore, arquivo_imagem);
+    }
+
+    // Guarda so as n ultimas versoes, liberando as mais antigas; consultas a versoes
+    // expiradas respondem como a mais antiga retida. Com 0, guarda todas
+    void retem_ultimas_versoes(size_t n)
+    {
+        arvore.retem_ultimas_versoes(n);
+    }
+
+    // Grava todas as versoes numa imagem, para uma proxima execucao partir dela. Com um
+    // diario aberto, ele eh esvaziado depois, ja que a imagem contem tudo o que ele tinha
+    bool salva_imagem(const std::string& arquivo_imagem)
+    {
+        if (!ufc::eda::io::salva_imagem(arvore, arquivo_imagem))
+        {
+            return false;
+        }
+
+        return !_diario || _diario->reinicia(arvore.ultima_versao());
+    }
+
+    // Grava os custos de persistencia e a memoria da arvore, em JSON
+    bool salva_custos(const std::string& arquivo_custos) const
+    {
+        std::ofstream arquivo(arquivo_custos, std::ios::binary | std::ios::trunc);
+        arquivo << ufc::eda::io::utils::custos_em_json(arvore);
+        arquivo.close();
+
+        return !arquivo.fail();
+    }
+
+    // Passa a medir, a partir de agora, a latencia de cada operacao, os bytes escritos por
+    // cada IMP e quantas operacoes sao concluidas em cada janela de tempo. Desligadas, as
+    // estatisticas nao leem o relogio
+    void coleta_estatisticas(std::chrono::milliseconds janela = std::chrono::milliseconds(1000))
+    {
+        _estatisticas.reset(new estatisticas(janela));
+    }
+
+    // Estatisticas coletadas ate aqui, ou nullptr se nao estiverem ligadas
+    const estatisticas* estatisticas_coletadas() const
+    {
+        return _estatisticas.get();
+    }
+
+    // Grava as estatisticas coletadas em JSON; retorna false se nao estiverem ligadas
+    bool salva_estatisticas(const std::string& arquivo_estatisticas) const
+    {
+        if (!_estatisticas)
+        {
+            return false;
+        }
+
+        std::ofstream arquivo(arquivo_estatisticas, std::ios::binary | std::ios::trunc);
+        arquivo << _estatisticas->em_json();
+        arquivo.close();
+
+        return !arquivo.fail();
+    }
+
+    // Passa a registrar cada inclusao e remocao num diario, antes de aplica-la. Se o diario
+    // ja existir, primeiro reaplica as operacoes dele posteriores a versao atual (a da
+    // imagem carregada, ou a inicial), de modo que a recuperacao custa o trecho do diario
+    // que a imagem nao cobre, e nao o historico inteiro. Deve ser chamada depois de
+    // carrega_imagem e antes de qualquer operacao; retorna false se o diario nao puder ser
+    // aberto ou nao continuar a versao atual
+    bool abre_diario(const std::string& arquivo_diario,
+                     size_t operacoes_por_sincronizacao = diario::operacoes_por_sincronizacao_padrao)
+    {
+        const size_t versao = arvore.ultima_versao();
+
+        std::unique_ptr<diario> d(new diario(arquivo_diario, versao, operacoes_por_sincronizacao));
+        if (!d->aberto() || d->versao_base() > versao)
+        {
+            return false;
+        }
+
+        // Um diario que termina antes da imagem nao tem nada que ela nao tenha
+        if (d->versao_final() < versao)
+        {
+            if (!d->reinicia(versao))
+            {
+                return false;
+            }
+        }
+        else if (!d->reproduz(versao, [this](const ufc::eda::io::op& op) { aplica(op); }))
+        {
+            return false;
+        }
+
+        _diario = std::move(d);
+
+        return true;
+    }
+
+    // Leva ao disco o que falta do diario e o fecha. Retorna false se alguma escrita nele
+    // falhou; sem diario, nao ha o que fazer
+    bool fecha_diario()
+    {
+        const bool sucesso = !_diario || _diario->sincroniza();
+        _diario.reset();
+
+        return sucesso;
+    }
 
     void enfila(const ufc::eda::io::op& op)
     {
         _operacoes.push_back(op);
     }
 
-    void executa()
+    // Executa as operacoes enfiladas, que depois sao descartadas. Retorna false se a
+    // saida nao pode ser gravada
+    bool executa()
     {
-        ufc::eda::io::file_writer fwriter(arquivo_saida);
+        executa(_operacoes.begin(), _operacoes.end());
+        std::vector<op>().swap(_operacoes);
+
+        return conclui();
+    }
+
+    // Execucao em fluxo: aplica a operacao e escreve sua resposta assim que ela chega, sem
+    // guarda-la, de modo que a memoria fica limitada pela arvore e nao pelo tamanho da
+    // entrada. A saida fica aberta entre as chamadas, ate conclui(). Com mais de uma
+    // thread, as consultas seguidas sao guardadas (ate consultas_por_rodada) e respondidas
+    // em paralelo quando chega uma atualizacao
+    void executa(const ufc::eda::io::op& op)
+    {
+        if (!_pool)
+        {
+            executa(saida(), op);
+            return;
+        }
+
+        if (eh_consulta(op))
+        {
+            _consultas.push_back(op);
+            if (_consultas.size() == consultas_por_rodada)
+            {
+                escreve_consultas();
+            }
+            return;
+        }
+
+        escreve_consultas();
+        aplica(op);
+    }
+
+    // O mesmo, para um trecho de operacoes
+    template <typename iterador>
+    void executa(iterador inicio, iterador fim)
+    {
+        for (; inicio != fim; ++inicio)
+        {
+            executa(*inicio);
+        }
+    }
+
+    // Termina a execucao em fluxo, escrevendo o que falta e fechando o arquivo de saida,
+    // criado vazio se nenhuma operacao foi executada. O diario, se houver, eh sincronizado.
+    // Retorna false se a saida nao pode ser gravada (vide saida_gravada)
+    bool conclui()
+    {
+        escreve_consultas();
+        _saida_gravada = saida().flush() && _saida_gravada;
+        _fwriter.reset();
+
+        if (_diario)
+        {
+            _diario->sincroniza();
+        }
+
+        return _saida_gravada;
+    }
+
+    // Se todas as respostas escritas ate aqui chegaram ao arquivo de saida. Uma escrita
+    // que falhe (disco cheio, por exemplo) so aparece aqui, depois de conclui() ou de
+    // executa_em_pipeline()
+    bool saida_gravada() const
+    {
+        return _saida_gravada;
+    }
+
+    // Le, executa e escreve ao mesmo tempo, em tres threads ligadas por filas limitadas:
+    // o parser entrega lotes de operacoes; esta thread, a unica que escreve na arvore, as
+    // aplica e guarda as respostas das consultas; a ultima formata e escreve as respostas.
+    // O tempo total tende ao do estagio mais lento, em vez da soma dos tres. A saida eh a
+    // mesma de executa(). Retorna false se o arquivo de entrada nao puder ser lido; falhas
+    // na gravacao da saida ficam em saida_gravada()
+    bool executa_em_pipeline(ufc::eda::io::file_parser& fparser)
+    {
+        if (!fparser.aberto())
+        {
+            return false;
+        }
+
+        fila_spsc<std::vector<op>> lidas(lotes_em_transito);
+        fila_spsc<respostas> respondidas(lotes_em_transito);
+
+        std::thread leitor([&fparser, &lidas]() {
+            std::vector<op> lote;
+            lote.reserve(operacoes_por_lote);
+
+            fparser.parse([&lidas, &lote](const op& operacao) {
+                lote.push_back(operacao);
+                if (lote.size() == operacoes_por_lote)
+                {
+                    lidas.enfila(std::move(lote));
+                    lote.clear();
+                    lote.reserve(operacoes_por_lote);
+                }
+            });
+
+            if (!lote.empty())
+            {
+                lidas.enfila(std::move(lote));
+            }
+            lidas.encerra();
+        });
+
+        bool gravada = false;
+        std::thread escritor([this, &respondidas, &gravada]() {
+            ufc::eda::io::file_writer fwriter(arquivo_saida, ufc::eda::io::file_writer::saida::direta);
+
+            respostas r;
+            while (respondidas.desenfila(r))
+            {
+                escreve(fwriter, r);
+            }
+
+            gravada = fwriter.flush();
+        });
+
+        std::vector<op> lote;
+        while (lidas.desenfila(lote))
+        {
+            respostas r;
+
+            // Cada sequencia de consultas eh respondida antes da atualizacao que a encerra
+            const op* consultas = lote.data();
+            for (const op& operacao : lote)
+            {
+                if (!eh_consulta(operacao))
+                {
+                    responde(consultas, &operacao, r);
+                    aplica(operacao);
+                    consultas = &operacao + 1;
+                }
+            }
+            responde(consultas, lote.data() + lote.size(), r);
+
+            // Lotes so com inclusoes e remocoes nao tem o que escrever
+            if (!r.vazia())
+            {
+                respondidas.enfila(std::move(r));
+            }
+        }
+        respondidas.encerra();
 
-        for (const ufc::eda::io::op& op : _operacoes)
+        if (_diario)
         {
-            executa(fwriter, op);
+            _diario->sincroniza();
         }
+
+        leitor.join();
+        escritor.join();
+        _saida_gravada = gravada && _saida_gravada;
+
+        return true;
     }
 
 private:
-    void executa(ufc::eda::io::file_writer& fwriter, const ufc::eda::io::op& op)
+    using abb = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::MOTOR_PERSISTENCIA>;
+
+    // Formata as respostas como executa() as escreveria
+    void escreve(ufc::eda::io::file_writer& fwriter, const respostas& r) const
+    {
+        size_t inicio = 0;
+        for (const respostas::resposta& resposta : r.consultas)
+        {
+            const uint64_t escritos = fwriter.escritos();
+            fwriter << resposta.consulta;
+
+            if (resposta.consulta.tipoOperacao == ufc::eda::io::op::tipo::SUCESSAO)
+            {
+                if (resposta.fim_dados > inicio)
+                {
+                    fwriter << r.dados[inicio];
+                }
+                else
+                {
+                    fwriter << "INF";
+                }
+            }
+            else
+            {
+                for (size_t i = inicio; i < resposta.fim_dados; i += 3)
+                {
+                    if (i != inicio)
+                    {
+                        fwriter << ' ';
+                    }
+
+                    ufc::eda::io::utils::imprime_noh(fwriter, r.dados[i], r.dados[i + 1], arvore.rubro_negra(),
+                                                     static_cast<abb::cor_noh>(r.dados[i + 2]));
+                }
+            }
+
+            fwriter << '\n';
+            inicio = resposta.fim_dados;
+
+            if (_estatisticas && resposta.consulta.tipoOperacao == ufc::eda::io::op::tipo::IMPRESSAO)
+            {
+                _estatisticas->registra_impressao(fwriter.escritos() - escritos);
+            }
+        }
+    }
+
+    // Custo estimado de uma consulta IMP, que percorre a versao inteira, em consultas SUC,
+    // que descem um unico caminho; e custo de cada tarefa entregue ao pool
+    constexpr static const size_t custo_impressao = 64;
+    constexpr static const size_t custo_por_tarefa = 64;
+
+    static bool eh_consulta(const ufc::eda::io::op& op)
+    {
+        return op.tipoOperacao == ufc::eda::io::op::tipo::SUCESSAO ||
+               op.tipoOperacao == ufc::eda::io::op::tipo::IMPRESSAO;
+    }
+
+    void aplica(const ufc::eda::io::op& op)
     {
+        if (!_estatisticas)
+        {
+            atualiza(op);
+            return;
+        }
+
+        const estatisticas::relogio::time_point inicio = estatisticas::agora();
+        atualiza(op);
+        const estatisticas::relogio::time_point fim = estatisticas::agora();
+
+        _estatisticas->registra(op.tipoOperacao, inicio, fim);
+        _estatisticas->conclui(1, fim);
+    }
+
+    void atualiza(const ufc::eda::io::op& op)
+    {
+        if (_diario)
+        {
+            _diario->anexa(op);
+        }
+
         if (op.tipoOperacao == ufc::eda::io::op::tipo::INCLUSAO)
         {
             arvore.inclui(op.lparam);
@@ -48,27 +455,196 @@ private:
         {
             arvore.remove(op.lparam);
         }
-        else if (op.tipoOperacao == ufc::eda::io::op::tipo::SUCESSAO)
+    }
+
+    // Responde a consulta, guardando a resposta sem formata-la. A latencia medida eh a da
+    // busca na arvore; a formatacao fica para quem escreve
+    void responde(const ufc::eda::io::op& op, respostas& r) const
+    {
+        if (!_estatisticas)
         {
-            std::string str_sucessor = "INF";
+            busca(op, r);
+            return;
+        }
+
+        const estatisticas::relogio::time_point inicio = estatisticas::agora();
+        busca(op, r);
+        _estatisticas->registra(op.tipoOperacao, inicio, estatisticas::agora());
+    }
 
-            const int sucessor = arvore.sucessor(op.lparam, op.rparam);
-            if (sucessor != ufc::eda::persistencia::abb::inf)
+    void busca(const ufc::eda::io::op& op, respostas& r) const
+    {
+        if (op.tipoOperacao == ufc::eda::io::op::tipo::SUCESSAO)
+        {
+            const int* sucessor = arvore.busca_sucessor(op.lparam, op.rparam);
+            if (sucessor != nullptr)
             {
-                str_sucessor = std::to_string(sucessor);
+                r.dados.push_back(*sucessor);
             }
+        }
+        else
+        {
+            const size_t versao = arvore.versao_lida(static_cast<size_t>(op.lparam));
+            arvore.percorre_em_ordem(versao, [versao, &r](const abb::noh& x, int profundidade) {
+                r.dados.push_back(x.chave(versao));
+                r.dados.push_back(profundidade);
+                r.dados.push_back(static_cast<int>(x.cor(versao)));
+            });
+        }
+
+        r.consultas.push_back({ op, r.dados.size() });
+    }
 
-            fwriter << op << str_sucessor << "\n";
+    // Responde as consultas em [inicio, fim), em ordem. Nenhuma delas cria versao, entao
+    // todas leem versoes que nao mudam mais e podem ser respondidas em paralelo: o trecho
+    // eh dividido em tarefas de custo parecido, e as respostas de cada uma sao juntadas
+    // na ordem original
+    void responde(const ufc::eda::io::op* inicio, const ufc::eda::io::op* fim, respostas& r) const
+    {
+        std::vector<const ufc::eda::io::op*> limites { inicio };
+        if (_pool)
+        {
+            size_t custo = 0;
+            for (const ufc::eda::io::op* p = inicio; p != fim; ++p)
+            {
+                custo += p->tipoOperacao == ufc::eda::io::op::tipo::IMPRESSAO ? custo_impressao : 1;
+                if (custo >= custo_por_tarefa)
+                {
+                    limites.push_back(p + 1);
+                    custo = 0;
+                }
+            }
+        }
+        if (limites.back() != fim)
+        {
+            limites.push_back(fim);
+        }
+
+        const size_t tarefas = limites.size() - 1;
+        if (tarefas < 2)
+        {
+            for (const ufc::eda::io::op* p = inicio; p != fim; ++p)
+            {
+                responde(*p, r);
+            }
+            conta_concluidas(static_cast<size_t>(fim - inicio));
+            return;
+        }
+
+        std::vector<respostas> parciais(tarefas);
+        _pool->para_cada(tarefas, [this, &limites, &parciais](size_t t) {
+            for (const ufc::eda::io::op* p = limites[t]; p != limites[t + 1]; ++p)
+            {
+                responde(*p, parciais[t]);
+            }
+        });
+
+        for (const respostas& parcial : parciais)
+        {
+            r.anexa(parcial);
+        }
+        conta_concluidas(static_cast<size_t>(fim - inicio));
+    }
+
+    // As consultas de um trecho contam como concluidas quando todas foram respondidas
+    void conta_concluidas(size_t consultas) const
+    {
+        if (_estatisticas && consultas > 0)
+        {
+            _estatisticas->conclui(consultas, estatisticas::agora());
+        }
+    }
+
+    void escreve_consultas()
+    {
+        if (_consultas.empty())
+        {
+            return;
+        }
+
+        respostas r;
+        responde(_consultas.data(), _consultas.data() + _consultas.size(), r);
+        escreve(saida(), r);
+
+        _consultas.clear();
+    }
+
+    ufc::eda::io::file_writer& saida()
+    {
+        if (!_fwriter)
+        {
+            _fwriter.reset(new ufc::eda::io::file_writer(arquivo_saida, ufc::eda::io::file_writer::saida::direta));
+        }
+
+        return *_fwriter;
+    }
+
+    void executa(ufc::eda::io::file_writer& fwriter, const ufc::eda::io::op& op)
+    {
+        if (!eh_consulta(op))
+        {
+            aplica(op);
+            return;
+        }
+
+        if (!_estatisticas)
+        {
+            escreve(fwriter, op);
+            return;
+        }
+
+        // Aqui a consulta eh respondida e formatada de uma vez, e a latencia inclui as duas
+        const estatisticas::relogio::time_point inicio = estatisticas::agora();
+        const uint64_t escritos = fwriter.escritos();
+        escreve(fwriter, op);
+        const estatisticas::relogio::time_point fim = estatisticas::agora();
+
+        _estatisticas->registra(op.tipoOperacao, inicio, fim);
+        if (op.tipoOperacao == ufc::eda::io::op::tipo::IMPRESSAO)
+        {
+            _estatisticas->registra_impressao(fwriter.escritos() - escritos);
+        }
+        _estatisticas->conclui(1, fim);
+    }
+
+    // Responde a consulta direto na saida
+    void escreve(ufc::eda::io::file_writer& fwriter, const ufc::eda::io::op& op) const
+    {
+        if (op.tipoOperacao == ufc::eda::io::op::tipo::SUCESSAO)
+        {
+            fwriter << op;
+
+            const int* sucessor = arvore.busca_sucessor(op.lparam, op.rparam);
+            if (sucessor != nullptr)
+            {
+                fwriter << *sucessor;
+            }
+            else
+            {
+                fwriter << "INF";
+            }
+
+            fwriter << '\n';
         }
         else if (op.tipoOperacao == ufc::eda::io::op::tipo::IMPRESSAO)
         {
-            fwriter << op << ufc::eda::io::utils::to_string(arvore, op.lparam) << "\n";
+            fwriter << op;
+            ufc::eda::io::utils::imprime(fwriter, arvore, op.lparam);
+            fwriter << '\n';
         }
     }
 
     std::string arquivo_saida;
-    ufc::eda::persistencia::abb arvore;
+    abb arvore { abb::balanceamento::rubro_negro };
     std::vector<op> _operacoes;
+    std::unique_ptr<ufc::eda::io::file_writer> _fwriter;
+    bool _saida_gravada = true;
+
+    std::unique_ptr<pool_de_threads> _pool;
+    std::vector<op> _consultas;
+
+    std::unique_ptr<diario> _diario;
+    std::unique_ptr<estatisticas> _estatisticas;
 };
 
 }
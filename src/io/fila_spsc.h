@@ -0,0 +1,145 @@
+#ifndef FILA_SPSC_H_
+#define FILA_SPSC_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Fila limitada sem travas para exatamente um produtor e um consumidor, cada um na
+// sua thread. Eh um anel de capacidade potencia de 2: o produtor so escreve a cauda
+// e o consumidor so escreve a cabeca, entao basta publicar cada posicao com
+// release/acquire. Cada lado guarda a ultima posicao que viu do outro e so le de novo
+// o atomico quando ela nao basta, o que evita disputar a linha de cache a cada item
+template <typename T>
+class fila_spsc
+{
+public:
+    explicit fila_spsc(size_t capacidade_minima)
+    {
+        size_t capacidade = 2;
+        while (capacidade < capacidade_minima)
+        {
+            capacidade *= 2;
+        }
+
+        _itens.reset(new T[capacidade]);
+        _mascara = capacidade - 1;
+    }
+
+    fila_spsc(const fila_spsc&) = delete;
+    fila_spsc& operator=(const fila_spsc&) = delete;
+
+    // Apenas o produtor. Falha se a fila estiver cheia
+    bool tenta_enfilar(T& valor)
+    {
+        const size_t cauda = _cauda.load(std::memory_order_relaxed);
+        if (cauda - _cabeca_vista > _mascara)
+        {
+            _cabeca_vista = _cabeca.load(std::memory_order_acquire);
+            if (cauda - _cabeca_vista > _mascara)
+            {
+                return false;
+            }
+        }
+
+        _itens[cauda & _mascara] = std::move(valor);
+        _cauda.store(cauda + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Apenas o consumidor. Falha se a fila estiver vazia
+    bool tenta_desenfilar(T& valor)
+    {
+        const size_t cabeca = _cabeca.load(std::memory_order_relaxed);
+        if (cabeca == _cauda_vista)
+        {
+            _cauda_vista = _cauda.load(std::memory_order_acquire);
+            if (cabeca == _cauda_vista)
+            {
+                return false;
+            }
+        }
+
+        valor = std::move(_itens[cabeca & _mascara]);
+        _cabeca.store(cabeca + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Apenas o produtor. Espera enquanto a fila estiver cheia
+    void enfila(T&& valor)
+    {
+        for (size_t tentativas = 0; !tenta_enfilar(valor); tentativas++)
+        {
+            espera(tentativas);
+        }
+    }
+
+    // Apenas o produtor, depois do ultimo item: avisa o consumidor que nada mais vira
+    void encerra()
+    {
+        _encerrada.store(true, std::memory_order_release);
+    }
+
+    // Apenas o consumidor. Espera por um item; retorna false quando a fila foi
+    // encerrada e nao ha mais itens
+    bool desenfila(T& valor)
+    {
+        for (size_t tentativas = 0; !tenta_desenfilar(valor); tentativas++)
+        {
+            if (_encerrada.load(std::memory_order_acquire))
+            {
+                // Itens enfilados antes do encerramento ainda podem estar la
+                return tenta_desenfilar(valor);
+            }
+
+            espera(tentativas);
+        }
+
+        return true;
+    }
+
+private:
+    // Os estagios trocam lotes, entao a espera costuma ser curta: cede o processador
+    // algumas vezes antes de dormir, para nao girar em vao quando um estagio eh bem
+    // mais lento que o outro
+    static void espera(size_t tentativas)
+    {
+        if (tentativas < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    // Cabeca e cauda em linhas de cache separadas, cada uma junto do que o seu dono le
+    alignas(64) std::atomic<size_t> _cabeca { 0 };
+    size_t _cauda_vista = 0;
+
+    alignas(64) std::atomic<size_t> _cauda { 0 };
+    size_t _cabeca_vista = 0;
+
+    alignas(64) std::atomic<bool> _encerrada { false };
+    std::unique_ptr<T[]> _itens;
+    size_t _mascara = 0;
+};
+
+}
+}
+}
+
+#endif // FILA_SPSC_H_
@@ -1,10 +1,14 @@
 #ifndef FILE_PARSER_H_
 #define FILE_PARSER_H_
 
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "arquivo_mapeado.h"
 #include "operacao.h"
 
 namespace ufc
@@ -17,9 +21,21 @@ namespace io
 class file_parser
 {
 public:
-    file_parser(const std::string& filename)
+    // por_linhas le o arquivo com std::getline. mapeada mapeia o arquivo em memoria e o
+    // percorre no lugar, sem copiar linhas, indicada para arquivos grandes. As regras de
+    // interpretacao (e de descarte de linhas invalidas) sao as mesmas nas duas
+    enum class leitura { por_linhas, mapeada };
+
+    file_parser(const std::string& filename, leitura modo = leitura::por_linhas) : _modo(modo)
     {
-        file.open(filename);
+        if (modo == leitura::mapeada)
+        {
+            _mapeado.reset(new arquivo_mapeado(filename));
+        }
+        else
+        {
+            file.open(filename);
+        }
     }
 
     ~file_parser()
@@ -27,8 +43,33 @@ public:
         file.close();
     }
 
+    bool aberto() const
+    {
+        return _modo == leitura::mapeada ? _mapeado->aberto() : file.is_open();
+    }
+
+    // Guarda as operacoes lidas, acessiveis depois por operacoes()
     bool parse()
     {
+        if (_modo == leitura::mapeada)
+        {
+            // Estimativa folgada de uma operacao a cada 16 bytes, evitando realocacoes sucessivas
+            _operacoes.reserve(_operacoes.size() + _mapeado->tamanho() / 16);
+        }
+
+        return parse([this](const op& operacao) { _operacoes.push_back(operacao); });
+    }
+
+    // Entrega cada operacao ao consumidor assim que ela eh lida, na ordem do arquivo,
+    // sem guarda-las
+    template <typename consumidor>
+    bool parse(consumidor&& consome)
+    {
+        if (_modo == leitura::mapeada)
+        {
+            return parse_mapeado(consome);
+        }
+
         if (!file.is_open())
         {
             return false;
@@ -37,11 +78,7 @@ public:
         std::string linha;
         while (std::getline(file, linha))
         {
-            if (op* operacao = parse_line(linha))
-            {
-                _operacoes.push_back(*operacao);
-                delete operacao;
-            }
+            parse_line(linha.data(), linha.data() + linha.size(), consome);
         }
 
         return true;
@@ -53,60 +90,118 @@ public:
     }
 
 private:
-    op* parse_line(const std::string& linha)
+    template <typename consumidor>
+    bool parse_mapeado(consumidor& consome)
     {
-        if (linha.size() < 5 || linha[3] != ' ')
+        if (!_mapeado->aberto())
         {
-            return nullptr;
+            return false;
         }
 
-        const std::string instrucao = linha.substr(0, 3);
-        const std::string params = linha.substr(4);
+        const char* p = _mapeado->inicio();
+        const char* const fim = _mapeado->fim();
 
-        int n_espacos = 0;
-        for (char c : params)
+        // Paginas ja lidas sao liberadas aos poucos, para que a memoria residente nao
+        // cresca com o arquivo
+        size_t proximo_descarte = bytes_por_descarte;
+
+        while (p < fim)
         {
-            if (c == ' ')
+            const char* quebra = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(fim - p)));
+            const char* fim_linha = quebra != nullptr ? quebra : fim;
+
+            parse_line(p, fim_linha, consome);
+            p = fim_linha + 1;
+
+            if (p < fim && static_cast<size_t>(p - _mapeado->inicio()) >= proximo_descarte)
             {
-                n_espacos++;
+                _mapeado->descarta(p);
+                proximo_descarte = static_cast<size_t>(p - _mapeado->inicio()) + bytes_por_descarte;
             }
         }
-        if (n_espacos > 1)
+
+        return true;
+    }
+
+    constexpr static const size_t bytes_por_descarte = size_t(32) << 20;
+
+    // Instrucao de 3 letras como um inteiro, comparada de uma vez
+    constexpr static uint32_t codigo(const char* instrucao)
+    {
+        return (static_cast<uint32_t>(static_cast<unsigned char>(instrucao[0])) << 16) |
+               (static_cast<uint32_t>(static_cast<unsigned char>(instrucao[1])) << 8) |
+                static_cast<uint32_t>(static_cast<unsigned char>(instrucao[2]));
+    }
+
+    // Mesmo resultado de std::atoi no trecho [p, fim): ignora espacos iniciais, aceita
+    // sinal e para no primeiro caractere que nao eh digito (sem digitos, retorna 0)
+    static int le_inteiro(const char* p, const char* fim)
+    {
+        while (p != fim && (*p == ' ' || (*p >= '\t' && *p <= '\r')))
+        {
+            p++;
+        }
+
+        bool negativo = false;
+        if (p != fim && (*p == '-' || *p == '+'))
         {
-            return nullptr;
+            negativo = *p == '-';
+            p++;
         }
 
-        if (n_espacos == 0)
+        uint32_t valor = 0;
+        for (; p != fim && static_cast<unsigned>(*p - '0') < 10; p++)
         {
-            if (instrucao == "INC")
-            {
-                return new op(op::tipo::INCLUSAO, std::atoi(params.c_str()));
-            }
+            valor = valor * 10 + static_cast<uint32_t>(*p - '0');
+        }
 
-            if (instrucao == "REM")
-            {
-                return new op(op::tipo::REMOCAO, std::atoi(params.c_str()));
-            }
+        return static_cast<int>(negativo ? 0u - valor : valor);
+    }
 
-            if (instrucao == "IMP")
-            {
-                return new op(op::tipo::IMPRESSAO, std::atoi(params.c_str()));
-            }
+    // Linha no trecho [ini, fim), sem a quebra. Formatos aceitos: "INC x", "REM x",
+    // "IMP x" e "SUC x v", com exatamente um espaco separando cada parametro
+    template <typename consumidor>
+    void parse_line(const char* ini, const char* fim, consumidor& consome)
+    {
+        if (fim - ini < 5 || ini[3] != ' ')
+        {
+            return;
         }
 
-        if (n_espacos == 1 && instrucao == "SUC")
+        const char* params = ini + 4;
+        const char* espaco = static_cast<const char*>(std::memchr(params, ' ', static_cast<size_t>(fim - params)));
+        if (espaco != nullptr && std::memchr(espaco + 1, ' ', static_cast<size_t>(fim - espaco - 1)) != nullptr)
         {
-            const auto posEspaco = params.find(' ');
-            const std::string lparam = params.substr(0, posEspaco);
-            const std::string rparam = params.substr(posEspaco + 1);
-
-            return new op(op::tipo::SUCESSAO, std::atoi(lparam.c_str()), std::atoi(rparam.c_str()));
+            return;
         }
 
-        return nullptr;
+        const uint32_t instrucao = codigo(ini);
+        if (espaco == nullptr)
+        {
+            switch (instrucao)
+            {
+            case codigo("INC"):
+                consome(op(op::tipo::INCLUSAO, le_inteiro(params, fim)));
+                break;
+            case codigo("REM"):
+                consome(op(op::tipo::REMOCAO, le_inteiro(params, fim)));
+                break;
+            case codigo("IMP"):
+                consome(op(op::tipo::IMPRESSAO, le_inteiro(params, fim)));
+                break;
+            default:
+                break;
+            }
+        }
+        else if (instrucao == codigo("SUC"))
+        {
+            consome(op(op::tipo::SUCESSAO, le_inteiro(params, espaco), le_inteiro(espaco + 1, fim)));
+        }
     }
 
+    const leitura _modo;
     std::ifstream file;
+    std::unique_ptr<arquivo_mapeado> _mapeado;
     std::vector<op> _operacoes;
 };
 
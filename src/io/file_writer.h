@@ -1,9 +1,18 @@
 #ifndef FILE_WRITER_H_
 #define FILE_WRITER_H_
 
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <string>
-#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 #include "operacao.h"
 
@@ -14,15 +23,47 @@ namespace eda
 namespace io
 {
 
+// Acumula a saida num buffer em espaco de usuario e so escreve no arquivo quando ele
+// enche, num flush explicito ou no fechamento. As quebras de linha nao forcam flush.
+// Uma escrita que falha (disco cheio, por exemplo) descarta o resto da saida e fica
+// registrada: a partir dai, flush() retorna false
 class file_writer {
 public:
-    file_writer(const std::string& filename)
+    // fluxo escreve por um std::ofstream (em modo texto, como antes). direta usa
+    // write(2)/writev(2) sobre o descritor, sem a camada do fluxo; disponivel apenas
+    // em sistemas POSIX, onde produz os mesmos bytes (nos demais, equivale a fluxo)
+    enum class saida { fluxo, direta };
+
+    constexpr static const size_t capacidade_buffer = size_t(1) << 20;
+
+    file_writer(const std::string& filename, saida modo = saida::fluxo)
+        : _buffer(new char[capacidade_buffer])
     {
+#ifndef _WIN32
+        if (modo == saida::direta)
+        {
+            _descritor = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            return;
+        }
+#else
+        (void)modo;
+#endif
         file.open(filename);
     }
 
+    file_writer(const file_writer&) = delete;
+    file_writer& operator=(const file_writer&) = delete;
+
     ~file_writer()
     {
+        flush();
+
+#ifndef _WIN32
+        if (_descritor >= 0)
+        {
+            ::close(_descritor);
+        }
+#endif
         file.close();
     }
 
@@ -35,32 +76,211 @@ public:
 
     bool anexa(const op& operacao)
     {
-        return anexa(operacao.to_string()) && anexa("\n");
+        if (!aberto())
+        {
+            return false;
+        }
+
+        anexa(operacao.instrucao(), 3);
+        anexa(' ');
+        anexa(operacao.lparam);
+        if (operacao.rparam != -1)
+        {
+            anexa(' ');
+            anexa(operacao.rparam);
+        }
+
+        return anexa('\n');
     }
 
     bool anexa(const std::string& str)
     {
-        if (!file.is_open())
+        // Deixa o ambiente lidar com a forma adequada de quebra de linha
+        if (str == "\r\n")
+        {
+            return anexa('\n');
+        }
+
+        return anexa(str.data(), str.size());
+    }
+
+    bool anexa(const char* str)
+    {
+        return anexa(str, std::strlen(str));
+    }
+
+    bool anexa(char c)
+    {
+        if (!aberto())
         {
             return false;
         }
 
-        // Deixa o ambiente lidar com a forma adequada de quebra de linha
-        if (str == "\n" || str == "\r\n")
+        if (_ocupado == capacidade_buffer)
+        {
+            flush();
+        }
+
+        _buffer[_ocupado++] = c;
+
+        return true;
+    }
+
+    // Mesmos digitos de std::to_string, formatados direto no buffer
+    bool anexa(int valor)
+    {
+        if (!aberto())
+        {
+            return false;
+        }
+
+        char digitos[12];
+        char* fim = digitos + sizeof(digitos);
+        char* p = fim;
+
+        uint32_t absoluto = valor < 0 ? 0u - static_cast<uint32_t>(valor) : static_cast<uint32_t>(valor);
+        do
+        {
+            *--p = static_cast<char>('0' + absoluto % 10);
+            absoluto /= 10;
+        } while (absoluto != 0);
+
+        if (valor < 0)
+        {
+            *--p = '-';
+        }
+
+        return anexa(p, static_cast<size_t>(fim - p));
+    }
+
+    bool anexa(const char* dados, size_t tamanho)
+    {
+        if (!aberto())
         {
-            file << std::endl;
+            return false;
         }
-        else
+
+        if (_ocupado + tamanho <= capacidade_buffer)
         {
-            file << str;
+            std::memcpy(_buffer.get() + _ocupado, dados, tamanho);
+            _ocupado += tamanho;
+            return true;
         }
 
+        // Nao cabe: o que estava no buffer e os novos dados saem juntos, sem passar
+        // os dados pelo buffer
+        escreve(_buffer.get(), _ocupado, dados, tamanho);
+        _ocupado = 0;
+
         return true;
     }
 
+    // Bytes recebidos desde a abertura, inclusive os que ainda estao no buffer
+    uint64_t escritos() const
+    {
+        return _descarregados + _ocupado;
+    }
+
+    // Retorna false se o arquivo nao abriu ou se alguma escrita, desta ou de antes, falhou
+    bool flush()
+    {
+        if (_ocupado > 0)
+        {
+            escreve(_buffer.get(), _ocupado, nullptr, 0);
+            _ocupado = 0;
+        }
+
+        if (file.is_open())
+        {
+            file.flush();
+            _falhou = _falhou || file.fail();
+        }
+
+        return aberto() && !_falhou;
+    }
+
 private:
+    bool aberto() const
+    {
+#ifndef _WIN32
+        if (_descritor >= 0)
+        {
+            return true;
+        }
+#endif
+        return file.is_open();
+    }
+
+    void escreve(const char* a, size_t tamanho_a, const char* b, size_t tamanho_b)
+    {
+        _descarregados += tamanho_a + tamanho_b;
+        if (_falhou)
+        {
+            return;
+        }
+
+#ifndef _WIN32
+        if (_descritor >= 0)
+        {
+            escreve_direto(a, tamanho_a, b, tamanho_b);
+            return;
+        }
+#endif
+        file.write(a, static_cast<std::streamsize>(tamanho_a));
+        file.write(b, static_cast<std::streamsize>(tamanho_b));
+        _falhou = file.fail();
+    }
+
+#ifndef _WIN32
+    // writev pode escrever parcialmente, ou ser interrompido por um sinal antes de escrever;
+    // repete ate esgotar os dois trechos ou ate um erro de verdade
+    void escreve_direto(const char* a, size_t tamanho_a, const char* b, size_t tamanho_b)
+    {
+        struct iovec trechos[2] = {
+            { const_cast<char*>(a), tamanho_a },
+            { const_cast<char*>(b), tamanho_b }
+        };
+
+        struct iovec* atual = trechos;
+        int restantes = 2;
+        while (restantes > 0)
+        {
+            const ssize_t escritos = ::writev(_descritor, atual, restantes);
+            if (escritos < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                _falhou = true;
+                return;
+            }
+
+            size_t consumidos = static_cast<size_t>(escritos);
+            while (restantes > 0 && consumidos >= atual->iov_len)
+            {
+                consumidos -= atual->iov_len;
+                atual++;
+                restantes--;
+            }
+
+            if (restantes > 0)
+            {
+                atual->iov_base = static_cast<char*>(atual->iov_base) + consumidos;
+                atual->iov_len -= consumidos;
+            }
+        }
+    }
+
+    int _descritor = -1;
+#endif
+
     std::ofstream file;
-    std::vector<op> _operacoes;
+    std::unique_ptr<char[]> _buffer;
+    size_t _ocupado = 0;
+    uint64_t _descarregados = 0;
+    bool _falhou = false;
 };
 
 }
@@ -0,0 +1,467 @@
+#ifndef GERADOR_DE_CARGA_H_
+#define GERADOR_DE_CARGA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "operacao.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Gera uma sequencia sintetica de operacoes (INC, REM, SUC e IMP, vide SPEC.md) a partir de
+// uma semente. A sequencia depende so da semente e dos parametros: o sorteio usa um gerador
+// proprio e aritmetica inteira (ponto fixo para Zipf e para o vies das versoes), e nao as
+// distribuicoes da biblioteca padrao nem <cmath>, cujos resultados mudam de uma
+// implementacao para outra. Os parametros reais sao convertidos para ponto fixo uma vez, na
+// construcao. Nada eh guardado por operacao, entao a memoria nao cresce com a quantidade
+// gerada
+class gerador_de_carga
+{
+public:
+    // uniforme: chaves equiprovaveis no intervalo
+    // zipf: a chave de posicao k no ranking sai com probabilidade proporcional a 1/k^s,
+    //       com as posicoes espalhadas pelo intervalo
+    // monotonica: chaves crescentes; as remocoes tiram a mais antiga ainda presente
+    // adversaria: chaves alternando entre as pontas do intervalo e convergindo para o
+    //             meio, o que degenera a arvore sem balanceamento numa corrente em
+    //             zigue-zague; os sucessores procuram a ultima chave incluida, a mais funda
+    enum class distribuicao { uniforme, zipf, monotonica, adversaria };
+
+    struct parametros
+    {
+        uint64_t semente = 1;
+
+        // Percentual de consultas (SUC) entre as operacoes, e de remocoes entre as atualizacoes
+        unsigned percentual_de_leituras = 50;
+        unsigned percentual_de_remocoes = 33;
+
+        // Uma IMP a cada tantas operacoes; com 0, nenhuma
+        uint64_t impressao_a_cada = 0;
+
+        distribuicao chaves = distribuicao::uniforme;
+        uint32_t intervalo = 1000000;
+        double expoente_zipf = 1.0;
+
+        // Vies das versoes consultadas: com 0, uniformes entre a 0 e a ultima; quanto
+        // maior, mais concentradas nas recentes
+        double vies_das_versoes = 0.0;
+    };
+
+    explicit gerador_de_carga(const parametros& p)
+        : _p(p), _estado(p.semente), _zipf(p.intervalo, p.expoente_zipf), _espalhamento(espalhamento(p.intervalo)),
+          _expoente_das_versoes(um + para_ponto_fixo(p.vies_das_versoes))
+    {
+    }
+
+    // Proxima operacao da sequencia
+    op proxima()
+    {
+        _geradas++;
+
+        if (_p.impressao_a_cada > 0 && _geradas % _p.impressao_a_cada == 0)
+        {
+            return op(op::tipo::IMPRESSAO, versao_consultada());
+        }
+
+        if (sorteia(100) < _p.percentual_de_leituras)
+        {
+            const int chave = chave_consultada();
+            return op(op::tipo::SUCESSAO, chave, versao_consultada());
+        }
+
+        _versao++;
+        if (sorteia(100) < _p.percentual_de_remocoes)
+        {
+            return op(op::tipo::REMOCAO, chave_removida());
+        }
+
+        return op(op::tipo::INCLUSAO, chave_incluida());
+    }
+
+    // Versao da arvore depois das operacoes geradas ate aqui
+    uint64_t versao() const
+    {
+        return _versao;
+    }
+
+    static bool le_distribuicao(const std::string& nome, distribuicao& d)
+    {
+        static const char* const nomes[] = { "uniforme", "zipf", "monotonica", "adversaria" };
+        for (size_t i = 0; i < 4; i++)
+        {
+            if (nome == nomes[i])
+            {
+                d = static_cast<distribuicao>(i);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    // Aritmetica de ponto fixo com 30 bits de fracao. As funcoes de <cmath> nao sao
+    // corretamente arredondadas e mudam de uma libm (ou de uma opcao de compilacao) para
+    // outra; com inteiros, o resultado eh o mesmo em qualquer plataforma
+    static const int bits = 30;
+    static const int64_t um = int64_t(1) << bits;
+    static const int64_t ln_2 = 744261118;       // ln(2) * 2^30
+    static const int64_t log2_e = 1549082005;    // log2(e) * 2^30
+
+    // Expoentes acima disso ja zeram todas as potencias representaveis
+    static int64_t para_ponto_fixo(double v)
+    {
+        return static_cast<int64_t>((v < 1024.0 ? v : 1024.0) * static_cast<double>(um));
+    }
+
+    static uint64_t magnitude(int64_t v)
+    {
+        return v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    }
+
+    static int64_t com_sinal(uint64_t v, bool negativo)
+    {
+        return negativo ? -static_cast<int64_t>(v) : static_cast<int64_t>(v);
+    }
+
+    // (a * b) >> deslocamento, com o produto de 128 bits montado em partes de 32
+    static uint64_t multiplica_sem_sinal(uint64_t a, uint64_t b, unsigned deslocamento)
+    {
+        const uint64_t m = 0xffffffffull;
+        const uint64_t ll = (a & m) * (b & m);
+        const uint64_t lh = (a & m) * (b >> 32);
+        const uint64_t hl = (a >> 32) * (b & m);
+        const uint64_t hh = (a >> 32) * (b >> 32);
+        const uint64_t meio = (ll >> 32) + (lh & m) + (hl & m);
+        const uint64_t baixo = (meio << 32) | (ll & m);
+        const uint64_t alto = hh + (lh >> 32) + (hl >> 32) + (meio >> 32);
+
+        return (baixo >> deslocamento) | (alto << (64 - deslocamento));
+    }
+
+    static int64_t multiplica(int64_t a, int64_t b)
+    {
+        return com_sinal(multiplica_sem_sinal(magnitude(a), magnitude(b), bits), (a < 0) != (b < 0));
+    }
+
+    // a / b, por divisao longa nos bits da fracao
+    static int64_t divide(int64_t a, int64_t b)
+    {
+        const uint64_t d = magnitude(b);
+        uint64_t q = magnitude(a) / d;
+        uint64_t r = magnitude(a) % d;
+        for (int i = 0; i < bits; i++)
+        {
+            r <<= 1;
+            q <<= 1;
+            if (r >= d)
+            {
+                r -= d;
+                q |= 1;
+            }
+        }
+
+        return com_sinal(q, (a < 0) != (b < 0));
+    }
+
+    // log2 de x > 0: a parte inteira pelo bit mais alto, a fracao bit a bit elevando a
+    // mantissa ao quadrado
+    static int64_t log2(uint64_t x)
+    {
+        int p = 63;
+        while ((x >> p) == 0)
+        {
+            p--;
+        }
+
+        // Mantissa em [2^31, 2^32), representando [1, 2)
+        uint64_t m = p >= 31 ? x >> (p - 31) : x << (31 - p);
+        int64_t r = static_cast<int64_t>(p - bits) * um;
+        for (int64_t bit = um >> 1; bit > 0; bit >>= 1)
+        {
+            m = (m * m) >> 31;
+            if ((m >> 32) != 0)
+            {
+                m >>= 1;
+                r += bit;
+            }
+        }
+
+        return r;
+    }
+
+    // 2^y = 2^i * e^(f ln 2), com y = i + f e f em [0, 1); a serie de Taylor usa 32 bits de
+    // fracao. Satura em 2^32, acima de qualquer valor usado aqui
+    static int64_t exp2(int64_t y)
+    {
+        int64_t i = y / um;
+        int64_t f = y - i * um;
+        if (f < 0)
+        {
+            f += um;
+            i--;
+        }
+
+        if (i >= 32)
+        {
+            return int64_t(1) << 62;
+        }
+        if (i <= -63)
+        {
+            return 0;
+        }
+
+        const uint64_t g = (static_cast<uint64_t>(f) << 2) * 2977044472ull >> 32; // ln(2) * 2^32
+        uint64_t termo = uint64_t(1) << 32;
+        uint64_t soma = termo;
+        for (uint64_t k = 1; termo > 0; k++)
+        {
+            termo = ((termo * g) >> 32) / k;
+            soma += termo;
+        }
+
+        soma >>= 32 - bits;
+        return static_cast<int64_t>(i >= 0 ? soma << i : soma >> -i);
+    }
+
+    static int64_t ln(uint64_t x)
+    {
+        return multiplica(log2(x), ln_2);
+    }
+
+    static int64_t exp(int64_t y)
+    {
+        return exp2(multiplica(y, log2_e));
+    }
+
+    // Amostragem de Zipf por rejeicao-inversao (Hormann e Derflinger), em tempo constante e
+    // sem tabela, para qualquer tamanho de intervalo. Retorna posicoes em [1, n]. Em ponto
+    // fixo, as posicoes na casa do bilhao ficam perto da resolucao de h; com intervalos
+    // dessa ordem e expoente perto de 1, a frequencia das primeiras se desvia em poucos %
+    class amostrador_zipf
+    {
+    public:
+        amostrador_zipf(uint32_t n, double expoente)
+            : _n(n), _expoente(para_ponto_fixo(expoente)), _um_menos_expoente(um - _expoente)
+        {
+            _h_integral_x1 = h_integral(um + um / 2) - um;
+            _h_integral_n = h_integral(static_cast<int64_t>(n) * um + um / 2);
+            _s = 2 * um - h_integral_inversa(h_integral(2 * um + um / 2) - h(2));
+        }
+
+        // u uniforme em [0, 2^32)
+        template <typename uniforme>
+        uint64_t amostra(uniforme&& sorteia_u)
+        {
+            while (true)
+            {
+                const int64_t u = _h_integral_n - static_cast<int64_t>(multiplica_sem_sinal(sorteia_u(), static_cast<uint64_t>(_h_integral_n - _h_integral_x1), 32));
+                const int64_t x = h_integral_inversa(u);
+
+                int64_t k = (x + um / 2) / um;
+                k = k < 1 ? 1 : k > static_cast<int64_t>(_n) ? static_cast<int64_t>(_n) : k;
+                if (k * um - x <= _s || u >= h_integral(k * um + um / 2) - h(k))
+                {
+                    return static_cast<uint64_t>(k);
+                }
+            }
+        }
+
+    private:
+        // k^-expoente, para k inteiro
+        int64_t h(int64_t k) const
+        {
+            return exp2(-multiplica(_expoente, log2(static_cast<uint64_t>(k * um))));
+        }
+
+        int64_t h_integral(int64_t x) const
+        {
+            const int64_t log_x = ln(static_cast<uint64_t>(x));
+            return multiplica(auxiliar_2(multiplica(_um_menos_expoente, log_x)), log_x);
+        }
+
+        int64_t h_integral_inversa(int64_t x) const
+        {
+            int64_t t = multiplica(x, _um_menos_expoente);
+            t = t <= -um ? -um + 1 : t;
+            return exp(multiplica(auxiliar_1(t), x));
+        }
+
+        // log(1 + x) / x e (exp(x) - 1) / x, pela serie perto de 0
+        static int64_t auxiliar_1(int64_t x)
+        {
+            if (magnitude(x) > static_cast<uint64_t>(um / 2))
+            {
+                return divide(ln(static_cast<uint64_t>(um + x)), x);
+            }
+
+            int64_t soma = um;
+            int64_t potencia = um;
+            for (int64_t k = 2; potencia != 0; k++)
+            {
+                potencia = multiplica(potencia, -x);
+                soma += potencia / k;
+            }
+
+            return soma;
+        }
+
+        static int64_t auxiliar_2(int64_t x)
+        {
+            if (magnitude(x) > static_cast<uint64_t>(um))
+            {
+                return divide(exp(x) - um, x);
+            }
+
+            int64_t soma = um;
+            int64_t termo = um;
+            for (int64_t k = 2; termo != 0; k++)
+            {
+                termo = multiplica(termo, x) / k;
+                soma += termo;
+            }
+
+            return soma;
+        }
+
+        const uint32_t _n;
+        const int64_t _expoente;
+        const int64_t _um_menos_expoente;
+        int64_t _h_integral_x1;
+        int64_t _h_integral_n;
+        int64_t _s;
+    };
+
+    // splitmix64: mesmo resultado em qualquer plataforma
+    uint64_t aleatorio()
+    {
+        uint64_t z = (_estado += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t sorteia(uint64_t n)
+    {
+        return aleatorio() % n;
+    }
+
+    // Multiplicador primo com o intervalo, que leva as posicoes do ranking de Zipf a chaves
+    // espalhadas por ele, sem repetir
+    static uint64_t espalhamento(uint32_t n)
+    {
+        uint64_t m = (static_cast<uint64_t>(n) * 2654435769ull >> 32) | 1u; // n * (sqrt(5) - 1) / 2
+        while (mdc(m, n) != 1)
+        {
+            m += 2;
+        }
+
+        return m;
+    }
+
+    static uint64_t mdc(uint64_t a, uint64_t b)
+    {
+        while (b != 0)
+        {
+            const uint64_t r = a % b;
+            a = b;
+            b = r;
+        }
+
+        return a;
+    }
+
+    int chave_sorteada()
+    {
+        if (_p.chaves == distribuicao::zipf)
+        {
+            const uint64_t posicao = _zipf.amostra([this]() { return aleatorio() >> 32; }) - 1;
+            return static_cast<int>(posicao * _espalhamento % _p.intervalo);
+        }
+
+        return static_cast<int>(sorteia(_p.intervalo));
+    }
+
+    // A i-esima chave das sequencias monotonica e adversaria
+    int chave_da_sequencia(uint64_t i) const
+    {
+        if (_p.chaves == distribuicao::monotonica)
+        {
+            return static_cast<int>(i % _p.intervalo);
+        }
+
+        // 0, n-1, 1, n-2, 2... e recomeca ao se encontrarem no meio
+        const uint64_t j = i % _p.intervalo;
+        return static_cast<int>(j % 2 == 0 ? j / 2 : _p.intervalo - 1 - j / 2);
+    }
+
+    bool eh_sequencia() const
+    {
+        return _p.chaves == distribuicao::monotonica || _p.chaves == distribuicao::adversaria;
+    }
+
+    int chave_incluida()
+    {
+        return eh_sequencia() ? chave_da_sequencia(_incluidas++) : chave_sorteada();
+    }
+
+    int chave_removida()
+    {
+        if (!eh_sequencia())
+        {
+            return chave_sorteada();
+        }
+
+        // A mais antiga ainda presente; sem nenhuma, uma remocao que nao acha a chave
+        return _removidas < _incluidas ? chave_da_sequencia(_removidas++) : chave_da_sequencia(_incluidas);
+    }
+
+    int chave_consultada()
+    {
+        if (_p.chaves == distribuicao::adversaria)
+        {
+            return _incluidas > 0 ? chave_da_sequencia(_incluidas - 1) - 1 : 0;
+        }
+
+        if (_p.chaves == distribuicao::monotonica)
+        {
+            return _incluidas > _removidas ? chave_da_sequencia(_removidas + sorteia(_incluidas - _removidas)) : 0;
+        }
+
+        return chave_sorteada();
+    }
+
+    int versao_consultada()
+    {
+        // u^(1 + vies) se concentra perto de 0 quando o vies cresce, e a distancia da ultima
+        // versao tambem
+        const uint64_t u = aleatorio() >> (64 - bits);
+        const uint64_t potencia = u == 0 ? 0 : static_cast<uint64_t>(exp2(multiplica(_expoente_das_versoes, log2(u))));
+        const uint64_t d = multiplica_sem_sinal(potencia, _versao + 1, bits);
+
+        return static_cast<int>(_versao - (d > _versao ? _versao : d));
+    }
+
+    const parametros _p;
+    uint64_t _estado;
+    amostrador_zipf _zipf;
+    const uint64_t _espalhamento;
+    const int64_t _expoente_das_versoes;
+
+    uint64_t _geradas = 0;
+    uint64_t _versao = 0;
+    uint64_t _incluidas = 0;
+    uint64_t _removidas = 0;
+};
+
+}
+}
+}
+
+#endif // GERADOR_DE_CARGA_H_
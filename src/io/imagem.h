@@ -0,0 +1,253 @@
+#ifndef IMAGEM_H_
+#define IMAGEM_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "arquivo_duravel.h"
+#include "arquivo_mapeado.h"
+#include "persistencia/abb.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Imagem binaria de uma arvore persistente inteira: todas as versoes e todos os nohs,
+// com os mods. Os nohs se referem uns aos outros por indice, e nao por endereco, entao
+// a imagem nao depende de onde eh carregada: carregar eh mapear o arquivo e apontar a
+// arvore para ele, sem ler nem corrigir nohs, e as paginas so sao lidas quando uma
+// consulta chega nelas.
+//
+// Formato (inteiros na ordem de bytes da maquina que gravou, conferida na carga):
+//   cabecalho_imagem, em 0
+//   raiz de cada versao (indice), a partir de inicio_raizes
+//   nohs, na ordem dos indices, a partir de inicio_nohs
+// Os trechos comecam em multiplos de 64 bytes
+namespace imagem
+{
+    struct cabecalho
+    {
+        char assinatura[8];
+        uint32_t versao_formato;
+        uint32_t ordem_bytes;
+        char motor[32];
+        uint32_t tamanho_noh;
+        uint32_t alinhamento_noh;
+        uint32_t tamanho_chave;
+        uint32_t rubro_negra;
+        uint64_t n_versoes;
+        uint64_t n_nohs;
+        uint64_t inicio_raizes;
+        uint64_t inicio_nohs;
+        uint64_t tamanho_arquivo;
+    };
+
+    constexpr static const char assinatura[8] = { 'A', 'B', 'B', 'P', 'E', 'R', 'S', '\0' };
+    constexpr static const uint32_t versao_formato = 1;
+    constexpr static const uint32_t ordem_bytes = 0x01020304;
+
+    inline uint64_t alinha(uint64_t deslocamento)
+    {
+        return (deslocamento + 63) / 64 * 64;
+    }
+
+    template <typename abb>
+    cabecalho descreve(const abb& arvore, uint64_t n_versoes, uint64_t n_nohs)
+    {
+        cabecalho c;
+        std::memset(&c, 0, sizeof(c));
+
+        std::memcpy(c.assinatura, assinatura, sizeof(c.assinatura));
+        c.versao_formato = versao_formato;
+        c.ordem_bytes = ordem_bytes;
+        std::strncpy(c.motor, abb::nome_do_motor(), sizeof(c.motor) - 1);
+        c.tamanho_noh = sizeof(typename abb::noh);
+        c.alinhamento_noh = alignof(typename abb::noh);
+        c.tamanho_chave = sizeof(typename abb::tipo_chave);
+        c.rubro_negra = arvore.rubro_negra() ? 1 : 0;
+        c.n_versoes = n_versoes;
+        c.n_nohs = n_nohs;
+        c.inicio_raizes = alinha(sizeof(cabecalho));
+        c.inicio_nohs = alinha(c.inicio_raizes + n_versoes * sizeof(typename abb::indice));
+        c.tamanho_arquivo = c.inicio_nohs + n_nohs * sizeof(typename abb::noh);
+
+        return c;
+    }
+
+    // Escreve em lotes, preenchendo com zeros ate o deslocamento de cada trecho
+    class gravador
+    {
+    public:
+        explicit gravador(const std::string& nome_arquivo)
+            : _arquivo(nome_arquivo, arquivo_duravel::abertura::cria_vazio)
+        {
+            _buffer.reserve(capacidade);
+        }
+
+        bool aberto() const
+        {
+            return _arquivo.aberto();
+        }
+
+        void anexa(const void* dados, size_t tamanho)
+        {
+            if (_buffer.size() + tamanho > capacidade)
+            {
+                descarrega();
+            }
+
+            const char* bytes = static_cast<const char*>(dados);
+            _buffer.insert(_buffer.end(), bytes, bytes + tamanho);
+            _escritos += tamanho;
+        }
+
+        void avanca_ate(uint64_t deslocamento)
+        {
+            static const char zeros[64] = {};
+            while (_escritos < deslocamento)
+            {
+                anexa(zeros, static_cast<size_t>(std::min<uint64_t>(sizeof(zeros), deslocamento - _escritos)));
+            }
+        }
+
+        // Escreve o que falta e so retorna quando a imagem inteira estiver no disco
+        bool conclui()
+        {
+            descarrega();
+
+            return !_falhou && _arquivo.sincroniza() && _arquivo.fecha();
+        }
+
+    private:
+        constexpr static const size_t capacidade = size_t(1) << 20;
+
+        void descarrega()
+        {
+            _falhou = !_arquivo.escreve(_buffer.data(), _buffer.size()) || _falhou;
+            _buffer.clear();
+        }
+
+        arquivo_duravel _arquivo;
+        bool _falhou = false;
+        std::vector<char> _buffer;
+        uint64_t _escritos = 0;
+    };
+}
+
+// Grava a imagem de todas as versoes publicadas. Grava num arquivo temporario e o renomeia
+// ao final, ja no disco, entao uma imagem anterior com o mesmo nome so eh substituida por
+// uma completa, mesmo numa queda da maquina
+template <template <typename, typename> class motor, typename chave, typename comparador>
+bool salva_imagem(const ufc::eda::persistencia::abb_persistente<motor, chave, comparador>& arvore, const std::string& nome_arquivo)
+{
+    using abb = ufc::eda::persistencia::abb_persistente<motor, chave, comparador>;
+    static_assert(std::is_trivially_copyable<typename abb::noh>::value, "a imagem copia os nohs byte a byte");
+
+    const size_t ultima = arvore.ultima_versao();
+    const size_t n_nohs = arvore.total_nohs();
+    const imagem::cabecalho c = imagem::descreve(arvore, ultima + 1, n_nohs);
+
+    const std::string temporario = nome_arquivo + ".tmp";
+    {
+        imagem::gravador g(temporario);
+        if (!g.aberto())
+        {
+            return false;
+        }
+
+        g.anexa(&c, sizeof(c));
+
+        g.avanca_ate(c.inicio_raizes);
+        for (size_t v = 0; v <= ultima; v++)
+        {
+            const typename abb::indice r = arvore.raiz(v);
+            g.anexa(&r, sizeof(r));
+        }
+
+        g.avanca_ate(c.inicio_nohs);
+        for (size_t i = 0; i < n_nohs; i++)
+        {
+            g.anexa(&arvore.obtem_noh(static_cast<typename abb::indice>(i)), sizeof(typename abb::noh));
+        }
+
+        if (!g.conclui())
+        {
+            std::remove(temporario.c_str());
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // No Windows, rename nao substitui um arquivo existente
+    std::remove(nome_arquivo.c_str());
+#endif
+
+    return std::rename(temporario.c_str(), nome_arquivo.c_str()) == 0 &&
+           arquivo_duravel::sincroniza_diretorio(nome_arquivo);
+}
+
+// Carrega a imagem numa arvore ainda sem versoes, do mesmo motor, tipo de chave e
+// balanceamento de quem a gravou. O arquivo fica mapeado enquanto a arvore existir; novas
+// versoes continuam a partir da ultima da imagem, e escritas em nohs antigos ficam so na
+// memoria do processo. O cabecalho e a tabela de raizes sao validados, com custo
+// proporcional as versoes; o conteudo dos nohs eh confiado a quem gravou
+template <template <typename, typename> class motor, typename chave, typename comparador>
+bool carrega_imagem(ufc::eda::persistencia::abb_persistente<motor, chave, comparador>& arvore, const std::string& nome_arquivo)
+{
+    using abb = ufc::eda::persistencia::abb_persistente<motor, chave, comparador>;
+
+    if (arvore.ultima_versao() != 0)
+    {
+        return false;
+    }
+
+    std::shared_ptr<arquivo_mapeado> mapa =
+        std::make_shared<arquivo_mapeado>(nome_arquivo, arquivo_mapeado::acesso::copia_na_escrita);
+    if (!mapa->aberto() || mapa->tamanho() < sizeof(imagem::cabecalho))
+    {
+        return false;
+    }
+
+    imagem::cabecalho lido;
+    std::memcpy(&lido, mapa->inicio(), sizeof(lido));
+
+    const imagem::cabecalho esperado = imagem::descreve(arvore, lido.n_versoes, lido.n_nohs);
+    if (std::memcmp(&lido, &esperado, sizeof(lido)) != 0 || lido.n_versoes == 0 || lido.n_nohs == 0 ||
+        lido.n_versoes - 1 > abb::versao_maxima ||
+        lido.tamanho_arquivo != mapa->tamanho())
+    {
+        return false;
+    }
+
+    // Uma raiz fora da arena faria a primeira consulta a sua versao ler alem dos nohs
+    char* base = mapa->inicio_gravavel();
+    typename abb::indice* raizes = reinterpret_cast<typename abb::indice*>(base + lido.inicio_raizes);
+    for (uint64_t v = 0; v < lido.n_versoes; v++)
+    {
+        if (raizes[v] >= lido.n_nohs)
+        {
+            return false;
+        }
+    }
+
+    arvore.adota(mapa,
+                 raizes, static_cast<size_t>(lido.n_versoes),
+                 reinterpret_cast<typename abb::noh*>(base + lido.inicio_nohs), static_cast<size_t>(lido.n_nohs));
+
+    return true;
+}
+
+}
+}
+}
+
+#endif // IMAGEM_H_
@@ -23,27 +23,31 @@ struct op
                rparam == outra.rparam;
     }
 
-    std::string to_string() const
+    // Mnemonico de 3 letras da instrucao, como no arquivo de entrada
+    const char* instrucao() const
     {
-        std::string str;
-
         if (tipoOperacao == tipo::INCLUSAO)
         {
-            str += "INC";
-        }
-        else if (tipoOperacao == tipo::REMOCAO)
-        {
-            str += "REM";
+            return "INC";
         }
-        else if (tipoOperacao == tipo::SUCESSAO)
+
+        if (tipoOperacao == tipo::REMOCAO)
         {
-            str += "SUC";
+            return "REM";
         }
-        else if (tipoOperacao == tipo::IMPRESSAO)
+
+        if (tipoOperacao == tipo::SUCESSAO)
         {
-            str += "IMP";
+            return "SUC";
         }
 
+        return "IMP";
+    }
+
+    std::string to_string() const
+    {
+        std::string str = instrucao();
+
         str += " ";
         str += std::to_string(lparam);
         if (rparam != -1)
@@ -0,0 +1,203 @@
+#ifndef POOL_DE_THREADS_H_
+#define POOL_DE_THREADS_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ufc
+{
+namespace eda
+{
+namespace io
+{
+
+// Threads fixas que executam juntas uma tarefa sobre um intervalo de indices, com roubo
+// de trabalho: cada thread comeca com uma faixa contigua do intervalo e consome a sua
+// pelo inicio; quem esvazia a sua rouba a metade final da faixa de outra. Tarefas de
+// custo muito diferente ficam assim equilibradas sem uma fila central disputada
+class pool_de_threads
+{
+public:
+    // threads conta tambem a thread que chama para_cada, que trabalha junto
+    explicit pool_de_threads(size_t threads)
+        : _faixas(new faixa[threads > 0 ? threads : 1]), _tamanho(threads > 0 ? threads : 1)
+    {
+        for (size_t id = 1; id < _tamanho; id++)
+        {
+            _threads.emplace_back([this, id]() { espera_trabalho(id); });
+        }
+    }
+
+    pool_de_threads(const pool_de_threads&) = delete;
+    pool_de_threads& operator=(const pool_de_threads&) = delete;
+
+    ~pool_de_threads()
+    {
+        {
+            std::lock_guard<std::mutex> trava(_trava);
+            _parando = true;
+        }
+        _tem_trabalho.notify_all();
+
+        for (std::thread& t : _threads)
+        {
+            t.join();
+        }
+    }
+
+    size_t tamanho() const
+    {
+        return _tamanho;
+    }
+
+    // Executa tarefa(i) para cada i em [0, n), em qualquer ordem e em paralelo, e so
+    // retorna quando todas terminarem. Nao pode ser chamada de dentro de uma tarefa
+    void para_cada(size_t n, const std::function<void(size_t)>& tarefa)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        // Faixas iniciais de tamanhos iguais, publicadas antes de acordar as threads
+        for (size_t id = 0; id < _tamanho; id++)
+        {
+            std::lock_guard<std::mutex> trava(_faixas[id].trava);
+            _faixas[id].inicio = n * id / _tamanho;
+            _faixas[id].fim = n * (id + 1) / _tamanho;
+        }
+
+        {
+            std::lock_guard<std::mutex> trava(_trava);
+            _tarefa = &tarefa;
+            _ocupadas = _tamanho - 1;
+            _geracao++;
+        }
+        _tem_trabalho.notify_all();
+
+        trabalha(0, tarefa);
+
+        std::unique_lock<std::mutex> trava(_trava);
+        _terminou.wait(trava, [this]() { return _ocupadas == 0; });
+        _tarefa = nullptr;
+    }
+
+private:
+    struct faixa
+    {
+        std::mutex trava;
+        size_t inicio = 0;
+        size_t fim = 0;
+    };
+
+    void espera_trabalho(size_t id)
+    {
+        size_t geracao_vista = 0;
+        for (;;)
+        {
+            const std::function<void(size_t)>* tarefa = nullptr;
+            {
+                std::unique_lock<std::mutex> trava(_trava);
+                _tem_trabalho.wait(trava, [this, geracao_vista]() { return _parando || _geracao != geracao_vista; });
+                if (_parando)
+                {
+                    return;
+                }
+
+                geracao_vista = _geracao;
+                tarefa = _tarefa;
+            }
+
+            trabalha(id, *tarefa);
+
+            bool ultima = false;
+            {
+                std::lock_guard<std::mutex> trava(_trava);
+                ultima = --_ocupadas == 0;
+            }
+            if (ultima)
+            {
+                _terminou.notify_one();
+            }
+        }
+    }
+
+    void trabalha(size_t id, const std::function<void(size_t)>& tarefa)
+    {
+        size_t i = 0;
+        while (pega(id, i) || (rouba(id) && pega(id, i)))
+        {
+            tarefa(i);
+        }
+    }
+
+    bool pega(size_t id, size_t& i)
+    {
+        faixa& propria = _faixas[id];
+        std::lock_guard<std::mutex> trava(propria.trava);
+        if (propria.inicio == propria.fim)
+        {
+            return false;
+        }
+
+        i = propria.inicio++;
+        return true;
+    }
+
+    // Procura, a partir da vizinha, uma faixa com trabalho e traz a metade final dela.
+    // Falha quando todas estao vazias: o que resta ja esta com as outras threads
+    bool rouba(size_t id)
+    {
+        for (size_t passo = 1; passo < _tamanho; passo++)
+        {
+            faixa& vitima = _faixas[(id + passo) % _tamanho];
+
+            size_t inicio = 0;
+            size_t fim = 0;
+            {
+                std::lock_guard<std::mutex> trava(vitima.trava);
+                const size_t restantes = vitima.fim - vitima.inicio;
+                if (restantes == 0)
+                {
+                    continue;
+                }
+
+                fim = vitima.fim;
+                inicio = fim - (restantes + 1) / 2;
+                vitima.fim = inicio;
+            }
+
+            faixa& propria = _faixas[id];
+            std::lock_guard<std::mutex> trava(propria.trava);
+            propria.inicio = inicio;
+            propria.fim = fim;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    std::vector<std::thread> _threads;
+    std::unique_ptr<faixa[]> _faixas;
+    const size_t _tamanho;
+
+    std::mutex _trava;
+    std::condition_variable _tem_trabalho;
+    std::condition_variable _terminou;
+    const std::function<void(size_t)>* _tarefa = nullptr;
+    size_t _geracao = 0;
+    size_t _ocupadas = 0;
+    bool _parando = false;
+};
+
+}
+}
+}
+
+#endif // POOL_DE_THREADS_H_
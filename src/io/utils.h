@@ -14,23 +14,149 @@ namespace io
 
     namespace utils
     {
-        inline std::string to_string(const ufc::eda::persistencia::abb& arvore, size_t versao)
+        // Escreve um noh da impressao: "chave,profundidade" e, na rubro-negra, ",R" ou ",N"
+        template <typename escritor, typename chave>
+        void imprime_noh(escritor& saida, const chave& k, int profundidade, bool rubro_negra, ufc::eda::persistencia::cor_noh cor)
         {
-            std::string str;
+            saida << k << ',' << profundidade;
+            if (rubro_negra)
+            {
+                saida << (cor == ufc::eda::persistencia::cor_noh::rubro ? ",R" : ",N");
+            }
+        }
+
+        // Escreve a impressao da versao ("chave,profundidade[,cor]" por noh, em ordem e
+        // separados por espaco) em qualquer saida com operator<< para chaves, int e char
+        template <typename escritor, template <typename, typename> class motor, typename chave, typename comparador>
+        void imprime(escritor& saida, const ufc::eda::persistencia::abb_persistente<motor, chave, comparador>& arvore, size_t versao)
+        {
+            using abb = ufc::eda::persistencia::abb_persistente<motor, chave, comparador>;
 
-            arvore.visita_em_ordem(versao, [versao, &arvore, &str](const ufc::eda::persistencia::abb::noh& x) {
-                str += std::to_string(x.chave(versao));
-                str += ",";
-                str += std::to_string(arvore.profundidade(versao, x));
-                str += " ";
+            versao = arvore.versao_lida(versao);
+            bool primeiro = true;
+            arvore.percorre_em_ordem(versao, [versao, &arvore, &saida, &primeiro](const typename abb::noh& x, int profundidade) {
+                if (!primeiro)
+                {
+                    saida << ' ';
+                }
+                primeiro = false;
+
+                imprime_noh(saida, x.chave(versao), profundidade, arvore.rubro_negra(), x.cor(versao));
             });
+        }
+
+        namespace detalhe
+        {
+            struct escritor_de_string
+            {
+                template <typename T>
+                escritor_de_string& operator<<(const T& valor)
+                {
+                    str += std::to_string(valor);
+                    return *this;
+                }
 
-            if (!str.empty())
+                escritor_de_string& operator<<(char c)
+                {
+                    str += c;
+                    return *this;
+                }
+
+                escritor_de_string& operator<<(const char* s)
+                {
+                    str += s;
+                    return *this;
+                }
+
+                std::string str;
+            };
+        }
+
+        template <template <typename, typename> class motor, typename chave, typename comparador>
+        std::string to_string(const ufc::eda::persistencia::abb_persistente<motor, chave, comparador>& arvore, size_t versao)
+        {
+            detalhe::escritor_de_string saida;
+            imprime(saida, arvore, versao);
+
+            return saida.str;
+        }
+
+        namespace detalhe
+        {
+            inline std::string custos_em_json(const ufc::eda::persistencia::custos_de_persistencia& c)
             {
-                str.pop_back();
+                return "{ \"nohs_criados\": " + std::to_string(c.nohs_criados) +
+                       ", \"copias\": " + std::to_string(c.copias) +
+                       ", \"mods\": " + std::to_string(c.mods) +
+                       ", \"raizes_trocadas\": " + std::to_string(c.raizes_trocadas) + " }";
             }
+        }
+
+        namespace detalhe
+        {
+            // Faixas nao vazias, cada uma pelo menor valor que conta
+            inline std::string histograma_em_json(const ufc::eda::persistencia::histograma& h)
+            {
+                std::string json = "{";
+                for (size_t i = 0; i < ufc::eda::persistencia::histograma::n_faixas; i++)
+                {
+                    if (h.contagem(i) == 0)
+                    {
+                        continue;
+                    }
+
+                    json += json.size() > 1 ? ", \"" : " \"";
+                    json += std::to_string(ufc::eda::persistencia::histograma::inicio_da_faixa(i)) + "\": " + std::to_string(h.contagem(i));
+                }
+
+                return json + (json.size() > 1 ? " }" : "}");
+            }
+
+            inline std::string instrumentacao_em_json(ufc::eda::persistencia::sem_instrumentacao)
+            {
+                return "";
+            }
+
+            inline std::string instrumentacao_em_json(ufc::eda::persistencia::instrumentacao_por_operacao)
+            {
+                using ufc::eda::persistencia::operacao_instrumentada;
+                static const char* const nomes[] = { "inclusao", "remocao", "sucessor", "percurso", "profundidade" };
+
+                std::string json = ",\n  \"instrumentacao\": {";
+                for (size_t i = 0; i < ufc::eda::persistencia::n_operacoes_instrumentadas; i++)
+                {
+                    const auto& d = ufc::eda::persistencia::instrumentacao_por_operacao::de(static_cast<operacao_instrumentada>(i));
+                    json += i > 0 ? ",\n" : "\n";
+                    json += "    \"" + std::string(nomes[i]) + "\": { \"operacoes\": " + std::to_string(d.slots_lidos.total()) +
+                            ", \"slots_lidos\": " + histograma_em_json(d.slots_lidos) +
+                            ", \"mods_recusados\": " + histograma_em_json(d.mods_recusados) +
+                            ", \"profundidade_da_cascata\": " + histograma_em_json(d.profundidade_da_cascata) + " }";
+                }
+
+                return json + "\n  }";
+            }
+        }
+
+        // Custos de persistencia e memoria da arvore (vide abb_persistente::custos_acumulados),
+        // num objeto JSON. Com um motor instrumentado, inclui as distribuicoes por operacao
+        template <template <typename, typename> class motor, typename chave, typename comparador>
+        std::string custos_em_json(const ufc::eda::persistencia::abb_persistente<motor, chave, comparador>& arvore)
+        {
+            std::string json = "{\n";
+            json += "  \"motor\": \"" + std::string(arvore.nome_do_motor()) + "\",\n";
+            json += "  \"ultima_versao\": " + std::to_string(arvore.ultima_versao()) + ",\n";
+            json += "  \"primeira_versao\": " + std::to_string(arvore.primeira_versao()) + ",\n";
+            json += "  \"nohs_vivos\": " + std::to_string(arvore.nohs_vivos()) + ",\n";
+            json += "  \"bytes_alocados\": " + std::to_string(arvore.bytes_alocados()) + ",\n";
+            json += "  \"bytes_adotados\": " + std::to_string(arvore.bytes_adotados()) + ",\n";
+            json += "  \"acumulado\": " + detalhe::custos_em_json(arvore.custos_acumulados()) + ",\n";
+            json += "  \"ultima_versao_custou\": " + detalhe::custos_em_json(arvore.custos_da_ultima_versao()) + ",\n";
+            json += "  \"maximo_por_versao\": " + detalhe::custos_em_json(arvore.maximo_por_versao()) + ",\n";
+            json += "  \"versao_com_mais_copias\": " + std::to_string(arvore.versao_com_mais_copias());
+            json += detalhe::instrumentacao_em_json(typename ufc::eda::persistencia::abb_persistente<motor, chave, comparador>::instrumentacao());
+            json += "\n}\n";
 
-            return str;
+            return json;
         }
     }
 
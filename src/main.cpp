@@ -1,4 +1,6 @@
 #include <iostream>
+#include <string>
+#include <thread>
 
 #include "io/arg_parser.h"
 #include "io/executor.h"
@@ -7,6 +9,11 @@
 #define SEM_ERRO                 0
 #define ERRO_ENTRADA_INVALIDA    1
 #define ERRO_ABERTURA_ARQUIVO    2
+#define ERRO_IMAGEM              3
+#define ERRO_DIARIO              4
+#define ERRO_CUSTOS              5
+#define ERRO_ESTATISTICAS        6
+#define ERRO_GRAVACAO_SAIDA      7
 
 namespace string_table_tabajara
 {
@@ -15,7 +22,17 @@ namespace string_table_tabajara
     constexpr static const char* STR_ERRO_ARQUIVO_SAIDA_INVALIDO = "Nome invalido do arquivo de saida!";
     constexpr static const char* STR_ERRO_ARQUIVOS_INVALIDOS = "Nome dos arquivos invalidos!";
     constexpr static const char* STR_ERRO_ABERTURA_ARQUIVO = "Nao foi possivel abrir o arquivo de entrada!";
-    constexpr static const char* STR_INSTRUCOES = "./cli [arquivo_entrada] [arquivo_saida]";
+    constexpr static const char* STR_ERRO_GRAVACAO_SAIDA = "Nao foi possivel gravar o arquivo de saida!";
+    constexpr static const char* STR_ERRO_OPCAO_INVALIDA = "Opcao invalida!";
+    constexpr static const char* STR_ERRO_CARGA_IMAGEM = "Nao foi possivel carregar a imagem!";
+    constexpr static const char* STR_ERRO_GRAVACAO_IMAGEM = "Nao foi possivel gravar a imagem!";
+    constexpr static const char* STR_ERRO_DIARIO = "Nao foi possivel abrir ou gravar o diario!";
+    constexpr static const char* STR_ERRO_GRAVACAO_CUSTOS = "Nao foi possivel gravar os custos!";
+    constexpr static const char* STR_ERRO_GRAVACAO_ESTATISTICAS = "Nao foi possivel gravar as estatisticas!";
+    constexpr static const char* STR_INSTRUCOES =
+        "./cli [arquivo_entrada] [arquivo_saida] [--carrega-imagem=arquivo] [--salva-imagem=arquivo] "
+        "[--diario=arquivo [--sincroniza-a-cada=operacoes]] [--retem-versoes=versoes] "
+        "[--custos=arquivo] [--estatisticas=arquivo]";
     constexpr static const char* STR_ROTINA_EXECUTADA_COM_SUCESSO = "Rotina executada com sucesso";
 }
 
@@ -49,26 +66,115 @@ int main(int argc, char** argv)
         {
             msg_erro = string_table_tabajara::STR_ERRO_ARQUIVO_SAIDA_INVALIDO;
         }
+        else if (status == ufc::eda::io::arg_parser::status::OPCAO_INVALIDA)
+        {
+            msg_erro = string_table_tabajara::STR_ERRO_OPCAO_INVALIDA;
+        }
 
         imprime_erro_na_saida_padrao(msg_erro);
 
         return ERRO_ENTRADA_INVALIDA;
     }
 
-    ufc::eda::io::file_parser fparser(arg_parser.arquivo_entrada());
-    if (!fparser.parse())
+    ufc::eda::io::file_parser fparser(arg_parser.arquivo_entrada(), ufc::eda::io::file_parser::leitura::mapeada);
+    ufc::eda::io::executor executor(arg_parser.arquivo_saida());
+
+    // As operacoes da entrada continuam a partir da ultima versao da imagem
+    const std::string& imagem_carregada = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_CARREGA_IMAGEM);
+    if (imagem_carregada != "" && !executor.carrega_imagem(imagem_carregada))
+    {
+        imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_CARGA_IMAGEM);
+
+        return ERRO_IMAGEM;
+    }
+
+    // O diario refaz as atualizacoes que a imagem nao tem e registra as da entrada
+    const std::string& arquivo_diario = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_DIARIO);
+    if (arquivo_diario != "")
+    {
+        const std::string& a_cada = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_SINCRONIZA_A_CADA);
+        const size_t operacoes_por_sincronizacao =
+            a_cada != "" ? std::stoul(a_cada) : ufc::eda::io::diario::operacoes_por_sincronizacao_padrao;
+
+        if (!executor.abre_diario(arquivo_diario, operacoes_por_sincronizacao))
+        {
+            imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_DIARIO);
+
+            return ERRO_DIARIO;
+        }
+    }
+
+    // Com retencao, a memoria fica limitada pelas ultimas versoes, e nao pelo historico
+    const std::string& versoes_retidas = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_RETEM_VERSOES);
+    if (versoes_retidas != "")
+    {
+        executor.retem_ultimas_versoes(std::stoul(versoes_retidas));
+    }
+
+    // Mede so as operacoes da entrada, e nao as reaplicadas do diario
+    const std::string& arquivo_estatisticas = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_ESTATISTICAS);
+    if (arquivo_estatisticas != "")
+    {
+        executor.coleta_estatisticas();
+    }
+
+    // Com mais de um nucleo, leitura, execucao e escrita correm em paralelo
+    bool sucesso = false;
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        sucesso = executor.executa_em_pipeline(fparser);
+    }
+    else if (fparser.aberto())
+    {
+        // Cada operacao eh executada assim que lida, sem guardar a entrada
+        fparser.parse([&executor](const ufc::eda::io::op& operacao) { executor.executa(operacao); });
+        executor.conclui();
+        sucesso = true;
+    }
+
+    if (!sucesso)
     {
         imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_ABERTURA_ARQUIVO);
 
         return ERRO_ABERTURA_ARQUIVO;
     }
 
-    ufc::eda::io::executor executor(arg_parser.arquivo_saida());
-    for (const ufc::eda::io::op& operacao : fparser.operacoes())
+    if (!executor.saida_gravada())
+    {
+        imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_GRAVACAO_SAIDA);
+
+        return ERRO_GRAVACAO_SAIDA;
+    }
+
+    const std::string& imagem_salva = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_SALVA_IMAGEM);
+    if (imagem_salva != "" && !executor.salva_imagem(imagem_salva))
+    {
+        imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_GRAVACAO_IMAGEM);
+
+        return ERRO_IMAGEM;
+    }
+
+    if (!executor.fecha_diario())
+    {
+        imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_DIARIO);
+
+        return ERRO_DIARIO;
+    }
+
+    const std::string& arquivo_custos = arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_CUSTOS);
+    if (arquivo_custos != "" && !executor.salva_custos(arquivo_custos))
     {
-        executor.enfila(operacao);
+        imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_GRAVACAO_CUSTOS);
+
+        return ERRO_CUSTOS;
+    }
+
+    if (arquivo_estatisticas != "" && !executor.salva_estatisticas(arquivo_estatisticas))
+    {
+        imprime_erro_na_saida_padrao(string_table_tabajara::STR_ERRO_GRAVACAO_ESTATISTICAS);
+
+        return ERRO_ESTATISTICAS;
     }
-    executor.executa();
 
     std::cout << "[OK] " << string_table_tabajara::STR_ROTINA_EXECUTADA_COM_SUCESSO << std::endl;
 
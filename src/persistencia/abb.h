@@ -3,17 +3,80 @@
  * @brief Implementação de uma estrutura de dados persistente de Árvore Binária de Busca (ABB).
  *
  * Esta classe fornece operações básicas de inclusão, remoção, busca de sucessor e conversão para string,
- * mantendo versões persistentes da árvore binária de busca.
+ * mantendo versões persistentes da árvore binária de busca. Opcionalmente, a árvore pode ser mantida
+ * balanceada como uma Árvore Rubro-Negra (variação da pós-graduação, vide SPEC.md), em que a cor de
+ * cada nó também é um campo versionado.
+ *
+ * A árvore é parametrizada pelo tipo da chave e por um comparador (menor estrito, `std::less` por
+ * padrão); chaves iguais segundo o comparador podem se repetir. Com chaves inteiras e a ordem natural,
+ * as comparações são especializadas em tempo de compilação (vide `ordem`, em definicoes.h).
+ *
+ * A forma de persistir os nós é uma política (o motor), escolhida em tempo de compilação:
+ * - `copia_de_nohs`: cópia de nós com 2p mods e ponteiro para o pai (padrão, vide `abb`);
+ * - `copia_de_nohs_sem_pai`: cópia de nós sem ponteiro para o pai, guiada pelo caminho da descida;
+ * - `copia_de_caminho`: cópia de caminho, com nós imutáveis e sem ponteiro para o pai.
+ *
+ * A árvore guarda a raiz de cada versão; o motor detém os nós e aplica as atualizações. Um motor é um
+ * template sobre o tipo da chave e o comparador, e deve oferecer `noh`, `obtem_noh(indice)`,
+ * `inclui(nova_versao, raiz, chave)` e `remove(nova_versao, raiz, chave)`, que retornam a raiz da
+ * nova versão, `profundidade(versao, raiz, noh)`, `leitura_concorrente`,
+ * `compacta(horizonte, novo_indice)`, os contadores `custos`, `bytes_alocados` e `bytes_adotados`
+ * e, para salvar e carregar imagens da árvore (vide io/imagem.h), `nome`, `total_nohs` e `adota`.
+ * O `noh` deve oferecer as leituras `chave`, `esq`, `dir` e `cor` de uma versão.
+ *
+ * Instrumentação: um motor pode declarar uma política de instrumentação do caminho quente
+ * (`instrumentacao`, vide instrumentacao.h), que a árvore avisa ao final de cada operação. Sem ela, ou
+ * com `sem_instrumentacao`, os avisos são vazios e não custam nada; `copia_de_nohs_instrumentada` é
+ * o `copia_de_nohs` que conta slots lidos, mods recusados e avisos em cascata por operação.
+ *
+ * Custos: a árvore conta, por versão e acumulado, os nós criados, as cópias (nós que substituem
+ * outro, por falta de mods ou por cópia de caminho), os mods escritos e as versões cuja raiz mudou,
+ * e informa os nós vivos e a memória ocupada. Contar custa poucas somas por atualização.
+ *
+ * Retenção: por padrão, todas as versões são guardadas para sempre. Com uma política de retenção
+ * (as últimas N versões, ou as a partir de uma versão V), as versões anteriores ao horizonte expiram
+ * e são lidas como a mais antiga retida, `primeira_versao()`. De tempos em tempos, as inclusões e
+ * remoções compactam a árvore: os nós que só versões expiradas alcançam são liberados, os mods que só
+ * guardam valores delas são descartados e as raízes delas saem da tabela, de modo que a memória fica
+ * limitada pelas versões retidas mesmo num fluxo sem fim de operações. Um nó vivo a partir do
+ * horizonte é alcançável na versão do horizonte ou foi criado depois dela, já que nós removidos ou
+ * substituídos nunca voltam à árvore; a compactação copia só esses para uma arena nova, com custo
+ * amortizado constante por operação.
+ *
+ * Um escritor e vários leitores: com um motor em que `leitura_concorrente` é verdadeiro (hoje, o
+ * `copia_de_caminho`), uma única thread pode chamar `inclui` e `remove` enquanto outras threads, sem
+ * travas, consultam (`busca_sucessor`, `sucessor`, `profundidade`, `visita_em_ordem` e
+ * `percorre_em_ordem`) qualquer versão até `ultima_versao()`. Cada versão nova só é publicada, de
+ * forma atômica, depois que todos os seus nós estão escritos, e a partir daí nenhum nó que ela
+ * alcança muda. Os demais motores alteram no lugar nós de versões publicadas e exigem que leituras e
+ * escritas não se sobreponham. A compactação move todos os nós, então a retenção também exige que
+ * leituras e escritas não se sobreponham, com qualquer motor.
+ *
+ * Limite de versões: os motores guardam versões em 32 bits, nos mods e nos nós, então a última versão
+ * possível é `versao_maxima` (2^32 - 1). Sem retenção, a memória acaba bem antes; com ela, um fluxo
+ * longo de operações (ou a reaplicação de um diário) pode chegar lá, e a inclusão ou remoção que
+ * criaria a versão seguinte lança `std::length_error` sem alterar a árvore, em vez de comparar mods
+ * com versões que deram a volta.
  */
 
 #ifndef ABB_H_
 #define ABB_H_
 
-#include <array>
+#include <algorithm>
+#include <atomic>
 #include <functional>
-#include <list>
-
-#define _MAXINT 2147483647
+#include <limits>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "persistencia/arena.h"
+#include "persistencia/copia_de_caminho.h"
+#include "persistencia/copia_de_nohs.h"
+#include "persistencia/copia_de_nohs_sem_pai.h"
+#include "persistencia/definicoes.h"
+#include "persistencia/instrumentacao.h"
 
 namespace ufc
 {
@@ -22,584 +85,512 @@ namespace eda
 namespace persistencia
 {
 
-class abb
+template <template <typename, typename> class motor, typename chave = int, typename comparador = std::less<chave>>
+class abb_persistente
 {
 public:
-    constexpr static const int inf = _MAXINT;
-
-    class noh
-    {
-        enum class campo { nenhum, chave, pai, filho_esq, filho_dir };
-        struct mod
-        {
-            mod() = default;
-            mod(size_t versao, campo campo_modificado, int valor)
-                : versao(versao), campo_modificado(campo_modificado), valor_inteiro(valor) {}
-            mod(size_t versao, campo campo_modificado, noh* valor)
-                : versao(versao), campo_modificado(campo_modificado), valor_ponteiro(valor) {}
-
-            bool disponivel() const
-            {
-                return campo_modificado == campo::nenhum;
-            }
-
-            size_t versao = 0;
-            campo campo_modificado = campo::nenhum;
-            int valor_inteiro = 0;
-            noh* valor_ponteiro = nullptr;
-        };
-
-    public:
-        noh(abb* parent) : _arvore_associada(parent) {};
-
-        noh* copia_compacta() const
-        {
-            auto noh_compactado = new noh(*this);
-
-            for (mod& m : noh_compactado->mods)
-            {
-                if (m.campo_modificado == campo::chave)
-                {
-                    noh_compactado->_chave = m.valor_inteiro;
-                }
-                else if (m.campo_modificado == campo::pai)
-                {
-                    noh_compactado->_pai = m.valor_ponteiro;
-                }
-                else if (m.campo_modificado == campo::filho_esq)
-                {
-                    noh_compactado->_esq = m.valor_ponteiro;
-                }
-                else if (m.campo_modificado == campo::filho_dir)
-                {
-                    noh_compactado->_dir = m.valor_ponteiro;
-                }
-
-                m = mod{};
-            }
-
-            return noh_compactado;
-        }
-
-        int chave(size_t versao) const
-        {
-            return acessa_campo_inteiro(campo::chave, versao);
-        }
-        void chave(size_t nova_versao, int n)
-        {
-            modifica_campo(nova_versao, campo::chave, n);
-        }
-
-        noh* pai(size_t versao) const
-        {
-            return acessa_campo_ponteiro(campo::pai, versao);
-        }
-        void pai(size_t nova_versao, noh* n)
-        {
-            modifica_campo(nova_versao, campo::pai, n);
-        }
-
-        noh* esq(size_t versao) const
-        {
-            return acessa_campo_ponteiro(campo::filho_esq, versao);
-        }
-        void esq(size_t nova_versao, noh* n)
-        {
-            modifica_campo(nova_versao, campo::filho_esq, n);
-        }
-
-        noh* dir(size_t versao) const
-        {
-            return acessa_campo_ponteiro(campo::filho_dir, versao);
-        }
-        void dir(size_t nova_versao, noh* n)
-        {
-            modifica_campo(nova_versao, campo::filho_dir, n);
-        }
+    using tipo_chave = chave;
 
-    private:
-        int acessa_campo_inteiro(campo c, size_t versao) const
-        {
-            int valor_do_campo_na_versao = acessa_campo_inteiro(c);
-
-            for (const mod& m : mods)
-            {
-                if (m.campo_modificado == c && m.versao <= versao)
-                {
-                    valor_do_campo_na_versao = m.valor_inteiro;
-                }
-            }
+    // Resultado de sucessor quando nao ha sucessor. So faz sentido para chaves com
+    // maximo (std::numeric_limits), e colide com uma chave igual ao maximo; em geral,
+    // prefira busca_sucessor
+    static const tipo_chave inf;
 
-            return valor_do_campo_na_versao;
-        }
-        noh* acessa_campo_ponteiro(campo c, size_t versao) const
-        {
-            noh* valor_do_campo_na_versao = acessa_campo_ponteiro(c);
+    using indice = ::ufc::eda::persistencia::indice;
+    constexpr static const indice nulo = ::ufc::eda::persistencia::nulo;
 
-            for (const mod& m : mods)
-            {
-                if (m.campo_modificado == c && m.versao <= versao)
-                {
-                    valor_do_campo_na_versao = m.valor_ponteiro;
-                }
-            }
+    // Ultima versao que os motores representam (vide acima)
+    constexpr static const size_t versao_maxima = std::numeric_limits<uint32_t>::max();
 
-            return valor_do_campo_na_versao;
-        }
+    using balanceamento = ::ufc::eda::persistencia::balanceamento;
+    using cor_noh = ::ufc::eda::persistencia::cor_noh;
+    using noh = typename motor<chave, comparador>::noh;
 
-        template <typename T>
-        void modifica_campo(size_t nova_versao, campo c, T t)
-        {
-            const mod m = { nova_versao, c, t };
-            if (!adiciona_mod(m))
-            {
-                noh* novo_noh = copia_compacta();
-                novo_noh->mods[0] = m;
+    // Se outras threads podem ler versoes publicadas enquanto uma escreve (vide acima)
+    constexpr static const bool leitura_concorrente = motor<chave, comparador>::leitura_concorrente;
 
-                avisa_observadores(nova_versao, novo_noh);
+    // Politica de instrumentacao do motor, avisada ao final de cada operacao (vide instrumentacao.h)
+    using instrumentacao = typename instrumentacao_do_motor<motor<chave, comparador>>::tipo;
 
-                // ToDo: aqui estava permitindo chamar direto a std::list
-                //       de nohs_unificados da abb. Nao deveria. Investigar.
-                _arvore_associada->_registra_noh(novo_noh);
-            }
-        }
-
-        int acessa_campo_inteiro(campo c) const
-        {
-            if (c == campo::chave)
-            {
-                return _chave;
-            }
+    abb_persistente(balanceamento b = balanceamento::nenhum) : _balanceamento(b), _motor(b)
+    {
+        // Versao 0: arvore vazia
+        raizes_nas_versoes.cria(nulo);
+    }
 
-            return _MAXINT;
-        }
+    // Ultima versao publicada
+    size_t ultima_versao() const
+    {
+        return _versao.load(std::memory_order_acquire);
+    }
 
-        noh* acessa_campo_ponteiro(campo c) const
-        {
-            if (c == campo::pai)
-            {
-                return _pai;
-            }
+    bool rubro_negra() const
+    {
+        return _balanceamento == balanceamento::rubro_negro;
+    }
 
-            if (c == campo::filho_esq)
-            {
-                return _esq;
-            }
+    const noh& obtem_noh(indice i) const
+    {
+        return _motor.obtem_noh(i);
+    }
 
-            if (c == campo::filho_dir)
-            {
-                return _dir;
-            }
+    // Versoes inexistentes (ou ainda nao publicadas) sao tratadas como a mais recente, e
+    // as expiradas, como a primeira retida
+    indice raiz(size_t versao) const
+    {
+        return static_cast<const arena<indice>&>(raizes_nas_versoes)[versao_lida(versao) - _primeira_versao_guardada];
+    }
 
-            return nullptr;
-        }
+    // Versao que as consultas a versao indicada de fato leem: a ultima, para versoes
+    // futuras, e a primeira retida, para as expiradas. Quem le campos dos nohs entregues
+    // por percorre_em_ordem deve le-los nesta versao
+    size_t versao_lida(size_t versao) const
+    {
+        const size_t ultima = ultima_versao();
+        return versao >= ultima ? ultima : std::max(versao, primeira_versao());
+    }
 
-        bool adiciona_mod(mod m)
-        {
-            bool adicionou = false;
+    // Versao mais antiga que ainda pode ser consultada
+    size_t primeira_versao() const
+    {
+        return std::max(horizonte(), _primeira_versao_guardada);
+    }
 
-            for (mod& mod_corrente : mods)
-            {
-                if (mod_corrente.disponivel())
-                {
-                    mod_corrente = m;
-                    adicionou = true;
-                    break;
-                }
-            }
+    // Guarda so as n ultimas versoes; com 0, volta a guardar todas
+    void retem_ultimas_versoes(size_t n)
+    {
+        const bool retinha = retencao_ativa();
+        _versoes_retidas = n;
+        inicia_marcas(retinha);
+    }
 
-            return adicionou;
-        }
+    // Guarda so as versoes a partir da indicada; com 0, volta a guardar todas
+    void retem_a_partir_da_versao(size_t versao)
+    {
+        const bool retinha = retencao_ativa();
+        _horizonte_fixo = versao;
+        inicia_marcas(retinha);
+    }
 
-        void avisa_observadores(size_t nova_versao, noh* novo_noh)
+    // Compacta agora, sem esperar pela proxima inclusao ou remocao que o faria
+    void compacta()
+    {
+        const size_t h = horizonte();
+        if (h > _primeira_versao_guardada)
         {
-            if (_esq != nullptr)
-            {
-                _esq->pai(nova_versao, novo_noh);
-            }
-            
-            if (_dir != nullptr)
-            {
-                _dir->pai(nova_versao, novo_noh);
-            }
-
-            if (_pai != nullptr)
-            {
-                if (this == _pai->_esq)
-                {
-                    _pai->esq(nova_versao, novo_noh);
-                }
-                else
-                {
-                    _pai->dir(nova_versao, novo_noh);
-                }
-            }
-            else
-            {
-                // Se o pai eh nulo, o noh eh raiz
-                // Precisa avisar a arvore tambem
-                _arvore_associada->raiz(nova_versao, novo_noh);
-            }
+            compacta(h);
         }
+    }
 
-        int _chave = _MAXINT;
-        noh* _pai = nullptr;
-        noh* _esq = nullptr;
-        noh* _dir = nullptr;
-        abb* _arvore_associada = nullptr;
+    // Nohs criados ate aqui, inclusive o nulo, com indices em [0, total_nohs())
+    size_t total_nohs() const
+    {
+        return _motor.total_nohs();
+    }
 
-        // Numa ABB, um noh em particular pode ser apontado por no maximo
-        // outros 3 nohs: seu pai, seu filho esquerdo e seu filho direito
-        // Logo, p = 3. Numa estrutura persistente, guardamos 2p mods = 6 mods
-        std::array<noh::mod, 6> mods;
-    };
+    static const char* nome_do_motor()
+    {
+        return motor<chave, comparador>::nome();
+    }
 
-    class noh_raiz
+    // Custos somados desde a criacao da arvore (ou desde a carga de uma imagem)
+    const custos_de_persistencia& custos_acumulados() const
     {
-        enum class campo { nenhum, noh };
-        struct mod
-        {
-            mod() = default;
-            mod(size_t versao, campo campo_modificado, noh* valor)
-                : versao(versao), campo_modificado(campo_modificado), valor(valor) {}
+        return _custos_acumulados;
+    }
 
-            bool disponivel() const
-            {
-                return campo_modificado == campo::nenhum;
-            }
+    const custos_de_persistencia& custos_da_ultima_versao() const
+    {
+        return _custos_da_ultima_versao;
+    }
 
-            size_t versao = 0;
-            campo campo_modificado = campo::nenhum;
-            noh* valor = nullptr;
-        };
+    // O maior valor de cada custo numa mesma versao, e a versao que mais copiou: uma
+    // tempestade de copias aparece aqui mesmo quando a media eh baixa
+    const custos_de_persistencia& maximo_por_versao() const
+    {
+        return _maximo_por_versao;
+    }
 
-    public:
-        noh_raiz(abb* arvore_associada) : _arvore(arvore_associada) {}
+    size_t versao_com_mais_copias() const
+    {
+        return _versao_com_mais_copias;
+    }
 
-        noh_raiz* copia_compacta() const
-        {
-            auto noh_raiz_compactado = new noh_raiz(*this);
+    // Nohs guardados, sem o nulo. Com retencao, so os que ainda servem as versoes retidas
+    size_t nohs_vivos() const
+    {
+        return total_nohs() - 1;
+    }
 
-            for (mod& m : noh_raiz_compactado->mods)
-            {
-                if (m.campo_modificado == campo::noh)
-                {
-                    noh_raiz_compactado->_noh = m.valor;
-                }
+    // Memoria alocada pela arvore (nohs, raizes das versoes e marcas de criacao) e memoria
+    // adotada de uma imagem, que fica com o arquivo mapeado
+    size_t bytes_alocados() const
+    {
+        return _motor.bytes_alocados() + raizes_nas_versoes.bytes_alocados() + _primeiro_noh_nas_versoes.bytes_alocados();
+    }
 
-                m = mod{};
-            }
+    size_t bytes_adotados() const
+    {
+        return _motor.bytes_adotados() + raizes_nas_versoes.bytes_adotados();
+    }
 
-            return noh_raiz_compactado;
-        }
+    // Troca o estado da arvore pelo de uma imagem ja na memoria (vide io/imagem.h): as
+    // raizes das versoes [0, n_versoes) e os nohs sao usados no lugar, sem copia, e dono
+    // mantem viva a memoria deles. Nao pode ser chamado com leitores concorrentes
+    void adota(const std::shared_ptr<void>& dono, indice* raizes, size_t n_versoes, noh* nohs, size_t n_nohs)
+    {
+        raizes_nas_versoes.adota(raizes, n_versoes, dono);
+        _primeira_versao_guardada = 0;
+        _motor.adota(nohs, n_nohs, dono);
+
+        // A imagem nao diz em que versao cada noh foi criado: ate o horizonte passar dela,
+        // a compactacao considera vivos todos os seus nohs
+        arena<indice> sem_marcas;
+        _primeiro_noh_nas_versoes.troca(sem_marcas);
+        _primeira_versao_marcada = n_versoes;
+        _nohs_apos_compactacao = n_nohs;
+
+        publica(n_versoes - 1);
+    }
 
-        noh* get_noh(size_t versao)
-        {
-            noh* _noh = nullptr;
+    void inclui(const tipo_chave& x)
+    {
+        const size_t novaVersao = cria_versao();
+        const custos_de_persistencia antes = custos_do_motor();
+        indice& r = raizes_nas_versoes[novaVersao - _primeira_versao_guardada];
+        const indice raiz_anterior = r;
+        r = _motor.inclui(novaVersao, r, x);
+        publica(novaVersao);
+        contabiliza(novaVersao, antes, r != raiz_anterior);
+        aplica_retencao();
+        instrumentacao::conclui(operacao_instrumentada::inclusao);
+    }
 
-            for (const mod& m : mods)
-            {
-                if (m.campo_modificado == campo::noh && m.versao <= versao)
-                {
-                    _noh = m.valor;
-                }
-            }
+    void remove(const tipo_chave& x)
+    {
+        const size_t novaVersao = cria_versao();
+        const custos_de_persistencia antes = custos_do_motor();
+        indice& r = raizes_nas_versoes[novaVersao - _primeira_versao_guardada];
+        const indice raiz_anterior = r;
+        r = _motor.remove(novaVersao, r, x);
+        publica(novaVersao);
+        contabiliza(novaVersao, antes, r != raiz_anterior);
+        aplica_retencao();
+        instrumentacao::conclui(operacao_instrumentada::remocao);
+    }
 
-            return _noh;
-        }
+    // Menor chave estritamente maior que x na versao, ou nullptr se nao houver. O ponteiro
+    // aponta para a chave guardada no noh, que nunca muda nem sai do lugar
+    const tipo_chave* busca_sucessor(const tipo_chave& x, size_t versao) const
+    {
+        // Com chaves repetidas (e, na rubro-negra, com rotacoes), iguais podem
+        // ficar dos dois lados de um noh. Uma descida unica guardando o ultimo
+        // candidato estritamente maior que x resolve sem depender de pai
+        const tipo_chave* candidato = nullptr;
 
-        void set_noh(size_t nova_versao, noh* n)
+        versao = versao_lida(versao);
+        indice n = raiz(versao);
+        while (n != nulo)
         {
-            bool adicionou = false;
-            for (mod& mod_corrente : mods)
+            const noh& corrente = obtem_noh(n);
+            if (_ordem.menor(x, corrente.chave(versao)))
             {
-                if (mod_corrente.disponivel())
-                {
-                    mod_corrente = { nova_versao, campo::noh, n };
-                    adicionou = true;
-                    break;
-                }
+                candidato = &corrente.chave(versao);
+                n = corrente.esq(versao);
             }
-
-            if (!adicionou)
+            else
             {
-                auto novo_noh_raiz = copia_compacta();
-                _arvore->_registra_raiz(nova_versao, novo_noh_raiz);
-                novo_noh_raiz->mods[0] = { nova_versao, campo::noh, n };
+                n = corrente.dir(versao);
             }
         }
 
-    private:
-        abb* _arvore = nullptr;
-        noh* _noh = nullptr;
-
-        // A ideia dessa classe eh ser um wrapper para a raiz, um "noh de noh".
-        // Apenas a propria arvore aponta para ele, logo, p = 1 => 2p = 2 mods
-        std::array<noh_raiz::mod, 2> mods;
-    };
-
-    abb()
-    {
-        _registra_raiz(0, new noh_raiz(this));
+        instrumentacao::conclui(operacao_instrumentada::sucessor);
+        return candidato;
     }
 
-    ~abb()
-    {
-        for (noh* noh_corrente : nohs_unificados)
-        {
-            delete noh_corrente;
-        }
-    }
-
-    size_t ultima_versao() const
+    tipo_chave sucessor(const tipo_chave& x, size_t versao) const
     {
-        return _versao;
+        const tipo_chave* s = busca_sucessor(x, versao);
+        return s != nullptr ? *s : inf;
     }
 
-    void inclui(int chave)
+    int profundidade(size_t versao, const noh& n) const
     {
-        const size_t novaVersao = ++_versao;
-
-        auto z = new noh(this);
-        z->chave(novaVersao, chave);
-        inclui(novaVersao, z);
+        versao = versao_lida(versao);
+        const int p = _motor.profundidade(versao, raiz(versao), n);
+        instrumentacao::conclui(operacao_instrumentada::profundidade);
 
-        _registra_noh(z);
+        return p;
     }
 
-    void remove(int chave)
+    void visita_em_ordem(size_t versao, std::function<void(const noh&)> visita) const
     {
-        const size_t novaVersao = ++_versao;
-
-        if (noh* z = busca(novaVersao, raiz(novaVersao), chave))
-        {
-            remove(novaVersao, z);
-        }
+        percorre_em_ordem(versao, [&visita](const noh& x, int) { visita(x); });
     }
 
-    int sucessor(int x, size_t versao) const
+    // Visita os nohs da versao em ordem, passando tambem a profundidade de cada um,
+    // que eh conhecida na descida. Iterativo, com pilha explicita: versoes degeneradas
+    // nao estouram a pilha de chamadas, e a pilha so aloca quando cresce
+    template <typename visitante>
+    void percorre_em_ordem(size_t versao, visitante&& visita) const
     {
-        const int menor_chave_arvore = min(versao, raiz(versao))->chave(versao);
-        if (x < menor_chave_arvore)
+        struct pendente
         {
-            return menor_chave_arvore;
-        }
+            indice n;
+            int profundidade;
+        };
+
+        std::vector<pendente> pilha;
+        pilha.reserve(64);
 
-        if (noh* n = busca_menor_igual(versao, x))
+        versao = versao_lida(versao);
+        indice x = raiz(versao);
+        int profundidade = 0;
+        while (x != nulo || !pilha.empty())
         {
-            if (n = sucessor(versao, n))
+            while (x != nulo)
             {
-                return n->chave(versao);
+                pilha.push_back({ x, profundidade++ });
+                x = obtem_noh(x).esq(versao);
             }
+
+            const pendente p = pilha.back();
+            pilha.pop_back();
+
+            const noh& corrente = obtem_noh(p.n);
+            visita(corrente, p.profundidade);
+
+            x = corrente.dir(versao);
+            profundidade = p.profundidade + 1;
         }
 
-        return _MAXINT;
+        instrumentacao::conclui(operacao_instrumentada::percurso);
     }
 
-    int profundidade(size_t versao, const noh& n) const
+private:
+    // A nova versao nasce com a mesma raiz da anterior, mas fica invisivel as consultas
+    // ate ser publicada
+    size_t cria_versao()
     {
-        const noh* x = &n;
+        const size_t anterior = _versao.load(std::memory_order_relaxed);
+        if (anterior >= versao_maxima)
+        {
+            throw std::length_error("abb_persistente: limite de versoes atingido");
+        }
 
-        int prof = 0;
-        while (x->pai(versao))
+        raizes_nas_versoes.cria(raizes_nas_versoes[anterior - _primeira_versao_guardada]);
+        if (retencao_ativa())
         {
-            x = x->pai(versao);
-            prof++;
+            _primeiro_noh_nas_versoes.cria(static_cast<indice>(total_nohs()));
         }
 
-        return prof;
+        return anterior + 1;
     }
 
-    void visita_em_ordem(size_t versao, std::function<void(const noh&)> visita) const
+    // Torna a versao, ja com a raiz e os nohs escritos, visivel as consultas
+    void publica(size_t versao)
     {
-        visita_em_ordem(versao, raiz(versao), visita);
+        _versao.store(versao, std::memory_order_release);
     }
 
-    void _registra_noh(noh* n)
+    bool retencao_ativa() const
     {
-        nohs_unificados.push_back(n);
+        return _versoes_retidas > 0 || _horizonte_fixo > 0;
     }
-    void _registra_raiz(size_t nova_versao, noh_raiz* nova_raiz)
-    {
-        raizes_nas_versoes.push_back({ nova_versao, nova_raiz });
-    }
-
-private:
-    // Referencias:
-    // https://www.youtube.com/watch?v=f7sIuYI5M2Y
-    // https://www.youtube.com/watch?v=QA2wFn9nQU4
 
-    void visita_em_ordem(size_t versao, noh* x, std::function<void(const noh&)> visita) const
+    // As marcas de criacao so sao registradas com retencao. Ao liga-la, as versoes
+    // anteriores ficam sem marca, e a compactacao as trata como as de uma imagem adotada
+    void inicia_marcas(bool retinha)
     {
-        if (x != nullptr)
+        if (!retinha && retencao_ativa())
         {
-            visita_em_ordem(versao, x->esq(versao), visita);
-            visita(*x);
-            visita_em_ordem(versao, x->dir(versao), visita);
+            arena<indice> sem_marcas;
+            _primeiro_noh_nas_versoes.troca(sem_marcas);
+            _primeira_versao_marcada = ultima_versao() + 1;
         }
     }
 
-    noh* busca(size_t versao, noh* x, int chave) const
+    // Custos acumulados pelo motor, com os nohs criados ate aqui
+    custos_de_persistencia custos_do_motor() const
     {
-        while (x != nullptr && x->chave(versao) != chave)
-        {
-            x = chave < x->chave(versao) ? x->esq(versao) : x->dir(versao);
-        }
+        custos_de_persistencia c = _motor.custos();
+        c.nohs_criados = total_nohs();
 
-        return x;
+        return c;
     }
 
-    noh* busca_menor_igual(size_t versao, int chave) const
+    // Atribui a versao recem-criada o que o motor gastou desde antes dela
+    void contabiliza(size_t versao, const custos_de_persistencia& antes, bool raiz_trocada)
     {
-        noh* x = raiz(versao);
-        noh* y = nullptr;
-        while (x != nullptr && x->chave(versao) != chave)
-        {
-            y = x;
-            x = chave < x->chave(versao) ? x->esq(versao) : x->dir(versao);
-        }
+        const custos_de_persistencia depois = custos_do_motor();
 
-        return x != nullptr ? x : y;
-    }
+        custos_de_persistencia& v = _custos_da_ultima_versao;
+        v.nohs_criados = depois.nohs_criados - antes.nohs_criados;
+        v.copias = depois.copias - antes.copias;
+        v.mods = depois.mods - antes.mods;
+        v.raizes_trocadas = raiz_trocada ? 1 : 0;
 
-    noh* min(size_t versao, noh* x) const
-    {
-        while (x->esq(versao) != nullptr)
+        if (v.copias > _maximo_por_versao.copias)
         {
-            x = x->esq(versao);
+            _versao_com_mais_copias = versao;
         }
-
-        return x;
+        _custos_acumulados.soma(v);
+        _maximo_por_versao.maximo(v);
     }
 
-    noh* sucessor(size_t versao, noh* x) const
+    // Versao mais antiga que a politica manda reter
+    size_t horizonte() const
     {
-        if (x->dir(versao) != nullptr && x->dir(versao)->chave(versao) != x->chave(versao))
-        {
-            return min(versao, x->dir(versao));
-        }
+        const size_t ultima = ultima_versao();
 
-        noh* y = x->pai(versao);
-        while (y != nullptr && x == y->dir(versao))
+        size_t h = _horizonte_fixo;
+        if (_versoes_retidas > 0 && ultima >= _versoes_retidas)
         {
-            x = y;
-            y = x->pai(versao);
+            h = std::max(h, ultima - _versoes_retidas + 1);
         }
 
-        return y;
+        return std::min(h, ultima);
     }
 
-    void inclui(size_t nova_versao, noh* z)
+    // Compacta quando os nohs dobram desde a ultima compactacao, ou quando as versoes
+    // expiradas ainda guardadas passam das retidas e dos nohs que sobraram nela (versoes
+    // que nao criam nohs tambem ocupam a tabela de raizes). Cada compactacao custa
+    // proporcional aos nohs que sobraram da anterior, e ao menos tantas operacoes quanto
+    // eles a separam da proxima
+    void aplica_retencao()
     {
-        noh* y = nullptr;
-        noh* x = raiz(nova_versao);
-
-        while (x != nullptr)
+        const size_t h = horizonte();
+        if (h <= _primeira_versao_guardada)
         {
-            y = x;
-            x = z->chave(nova_versao) < x->chave(nova_versao) ? x->esq(nova_versao) : x->dir(nova_versao);
+            return;
         }
 
-        z->pai(nova_versao, y);
-        if (y == nullptr)
+        const size_t expiradas = h - _primeira_versao_guardada;
+        const size_t retidas = ultima_versao() - h + 1;
+        if (expiradas >= std::max(std::max(retidas, _nohs_apos_compactacao), compactacao_minima) ||
+            total_nohs() >= 2 * _nohs_apos_compactacao + compactacao_minima)
         {
-            raiz(nova_versao, z);
-        }
-        else if (z->chave(nova_versao) < y->chave(nova_versao)) {
-            y->esq(nova_versao, z);
-        }
-        else {
-            y->dir(nova_versao, z);
+            compacta(h);
         }
     }
 
-    void remove(size_t nova_versao, noh* z)
+    // Indice do primeiro noh criado depois da versao, ou 0 se nao for conhecido
+    size_t primeiro_noh_apos(size_t versao) const
     {
-        if (z->esq(nova_versao) == nullptr)
+        if (versao >= ultima_versao())
         {
-            transplanta(nova_versao, z, z->dir(nova_versao));
+            return total_nohs();
         }
-        else if (z->dir(nova_versao) == nullptr)
-        {
-            transplanta(nova_versao, z, z->esq(nova_versao));
-        }
-        else
-        {
-            noh* y = sucessor(nova_versao, z);
-            transplanta(nova_versao, y, y->dir(nova_versao));
-
-            y->esq(nova_versao, z->esq(nova_versao));
-            z->esq(nova_versao)->pai(nova_versao, y);
-            y->dir(nova_versao, z->dir(nova_versao));
 
-            if (z->dir(nova_versao) != nullptr)
-            {
-                z->dir(nova_versao)->pai(nova_versao, y);
-            }
-            transplanta(nova_versao, z, y);
-        }
+        return versao + 1 >= _primeira_versao_marcada
+            ? _primeiro_noh_nas_versoes[versao + 1 - _primeira_versao_marcada]
+            : 0;
     }
 
-    void transplanta(size_t nova_versao, noh* u, noh* v)
+    // Descarta as versoes anteriores ao horizonte e tudo o que so elas alcancam. Os nohs
+    // vivos mantem a ordem de criacao na arena nova, entao as marcas de criacao das versoes
+    // retidas continuam validas depois de renumeradas
+    void compacta(size_t horizonte)
     {
-        if (u == nullptr)
+        const size_t ultima = ultima_versao();
+        const size_t total = total_nohs();
+        std::vector<indice> novo_indice(total, nulo);
+
+        // Vivos: os alcancaveis na versao do horizonte e os criados depois dela
+        std::vector<indice> pilha { raiz(horizonte) };
+        while (!pilha.empty())
         {
-            return;
+            const indice n = pilha.back();
+            pilha.pop_back();
+            if (n != nulo)
+            {
+                novo_indice[n] = 1;
+                pilha.push_back(obtem_noh(n).esq(horizonte));
+                pilha.push_back(obtem_noh(n).dir(horizonte));
+            }
         }
 
-        if (u->pai(nova_versao) == nullptr)
+        for (size_t i = std::max<size_t>(primeiro_noh_apos(horizonte), 1); i < total; i++)
         {
-            raiz(nova_versao, v);
+            novo_indice[i] = 1;
         }
-        else if (u == u->pai(nova_versao)->esq(nova_versao))
+
+        indice vivos = 1;
+        for (size_t i = 1; i < total; i++)
         {
-            u->pai(nova_versao)->esq(nova_versao, v);
+            if (novo_indice[i] != nulo)
+            {
+                novo_indice[i] = vivos++;
+            }
         }
-        else
+
+        _motor.compacta(horizonte, novo_indice);
+
+        arena<indice> raizes;
+        for (size_t v = horizonte; v <= ultima; v++)
         {
-            u->pai(nova_versao)->dir(nova_versao, v);
+            raizes.cria(novo_indice[raizes_nas_versoes[v - _primeira_versao_guardada]]);
         }
 
-        if (v != nullptr)
+        // As versoes depois do horizonte criaram nohs so a partir de primeiro_noh_apos, todos vivos
+        arena<indice> marcas;
+        const size_t primeira_marcada = std::max(horizonte + 1, _primeira_versao_marcada);
+        for (size_t v = primeira_marcada; v <= ultima; v++)
         {
-            v->pai(nova_versao, u->pai(nova_versao));
+            const indice marca = _primeiro_noh_nas_versoes[v - _primeira_versao_marcada];
+            marcas.cria(marca < total ? novo_indice[marca] : vivos);
         }
-    }
 
-    noh* raiz(size_t versao) const
-    {
-        return get_noh_raiz(versao)->get_noh(versao);
-    }
-    void raiz(size_t nova_versao, noh* n)
-    {
-        get_noh_raiz(nova_versao)->set_noh(nova_versao, n);
+        raizes_nas_versoes.troca(raizes);
+        _primeiro_noh_nas_versoes.troca(marcas);
+        _primeira_versao_guardada = horizonte;
+        _primeira_versao_marcada = primeira_marcada;
+        _nohs_apos_compactacao = vivos;
     }
 
-    noh_raiz* get_noh_raiz(size_t versao) const
-    {
-        for (auto i = static_cast<int>(raizes_nas_versoes.size()) - 1; i >= 0; i--)
-        {
-            const auto raiz_na_versao = raizes_nas_versoes[i];
-            if (versao >= raiz_na_versao.versao)
-            {
-                return raiz_na_versao.raiz;
-            }
-        }
+    // Menos que isso de versoes expiradas ou de nohs novos nao compensa compactar
+    constexpr static const size_t compactacao_minima = 4096;
 
-        return nullptr;
-    }
+    const balanceamento _balanceamento;
+    std::atomic<size_t> _versao { 0 };
 
-    struct par_versao_raiz
-    {
-        size_t versao;
-        noh_raiz* raiz;
-    };
+    // Tabela densa indexada pela versao (a partir da primeira guardada), acesso O(1) a raiz
+    // de qualquer versao. Escritas so ocorrem na ultima posicao, a da versao sendo criada,
+    // e a tabela cresce sem mover as raizes ja publicadas
+    arena<indice> raizes_nas_versoes;
+    size_t _primeira_versao_guardada = 0;
+
+    // Indice do primeiro noh criado por cada versao a partir de _primeira_versao_marcada,
+    // registrado so com retencao. Os indices crescem com a ordem de criacao, entao os nohs
+    // criados depois de uma versao sao um sufixo da arena
+    arena<indice> _primeiro_noh_nas_versoes;
+    size_t _primeira_versao_marcada = 1;
 
-    size_t _versao = 0;
-    std::vector<par_versao_raiz> raizes_nas_versoes;
-    std::list<noh*> nohs_unificados;
+    // Politica de retencao (0 guarda todas) e nohs que sobraram da ultima compactacao
+    size_t _versoes_retidas = 0;
+    size_t _horizonte_fixo = 0;
+    size_t _nohs_apos_compactacao = 1;
+
+    custos_de_persistencia _custos_acumulados;
+    custos_de_persistencia _custos_da_ultima_versao;
+    custos_de_persistencia _maximo_por_versao;
+    size_t _versao_com_mais_copias = 0;
+
+    const ordem<tipo_chave, comparador> _ordem = {};
+    motor<chave, comparador> _motor;
 };
 
+template <template <typename, typename> class motor, typename chave, typename comparador>
+const chave abb_persistente<motor, chave, comparador>::inf = std::numeric_limits<chave>::max();
+
+template <template <typename, typename> class motor, typename chave, typename comparador>
+constexpr const indice abb_persistente<motor, chave, comparador>::nulo;
+
+template <template <typename, typename> class motor, typename chave, typename comparador>
+constexpr const bool abb_persistente<motor, chave, comparador>::leitura_concorrente;
+
+using abb = abb_persistente<copia_de_nohs>;
+
 }
 }
 }
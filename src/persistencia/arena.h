@@ -0,0 +1,223 @@
+/**
+ * @file arena.h
+ * @brief Alocador em blocos (arena) para os nós da estrutura persistente.
+ *
+ * Os objetos são construídos sequencialmente dentro de blocos de capacidade fixa, de forma que
+ * cada alocação custa apenas o avanço de um índice e objetos criados em sequência (por exemplo,
+ * os nós tocados numa mesma operação) ficam próximos em memória. Cada objeto é identificado pela
+ * sua ordem de criação, um índice estável que pode ser guardado em 32 bits no lugar de um ponteiro.
+ * Nada é liberado individualmente: todos os objetos são destruídos de uma vez junto com a arena.
+ *
+ * Objetos já criados podem ser lidos por outras threads enquanto uma única thread cria novos: os
+ * blocos nunca se movem, e o diretório de blocos, quando cresce, é substituído por uma cópia maior
+ * publicada atomicamente, mantendo o antigo vivo para quem ainda o lê. Cabe a quem usa a arena
+ * publicar os índices novos (com release/acquire) só depois de construir os objetos.
+ *
+ * Uma arena também pode adotar objetos que já estão na memória (por exemplo, num arquivo mapeado),
+ * usando-os no lugar: os blocos completos apontam para a memória adotada, e apenas o último bloco,
+ * se incompleto, é copiado, para que novos objetos continuem na sequência dos índices.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+template <typename T, size_t objetos_por_bloco = 4096>
+class arena
+{
+    static_assert((objetos_por_bloco & (objetos_por_bloco - 1)) == 0, "objetos_por_bloco deve ser potencia de 2");
+
+public:
+    arena() = default;
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    ~arena()
+    {
+        destroi();
+    }
+
+    // Retorna o indice do objeto criado
+    template <typename... Args>
+    size_t cria(Args&&... args)
+    {
+        if (_blocos.empty() || _ocupados_ultimo_bloco == objetos_por_bloco)
+        {
+            novo_bloco();
+        }
+
+        void* endereco = &_blocos.back()[_ocupados_ultimo_bloco];
+        new (endereco) T(std::forward<Args>(args)...);
+        _ocupados_ultimo_bloco++;
+
+        return tamanho() - 1;
+    }
+
+    // Descarta os objetos atuais e passa a usar os n objetos em [objetos, objetos + n), que
+    // continuam onde estao. dono mantem viva a memoria deles enquanto a arena existir.
+    // Nao pode ser chamado com leitores concorrentes
+    void adota(T* objetos, size_t n, const std::shared_ptr<void>& dono)
+    {
+        static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+                      "so objetos trivialmente copiaveis podem ser adotados");
+
+        destroi();
+        _blocos.clear();
+        _alocados.clear();
+        _ocupados_ultimo_bloco = 0;
+        _dono_externo = dono;
+
+        const size_t completos = n / objetos_por_bloco;
+        for (size_t i = 0; i < completos; i++)
+        {
+            _blocos.push_back(reinterpret_cast<celula*>(objetos + i * objetos_por_bloco));
+            _ocupados_ultimo_bloco = objetos_por_bloco;
+        }
+
+        const size_t restantes = n % objetos_por_bloco;
+        if (restantes > 0)
+        {
+            _alocados.emplace_back(new celula[objetos_por_bloco]);
+            _blocos.push_back(_alocados.back().get());
+            std::memcpy(_blocos.back(), objetos + completos * objetos_por_bloco, restantes * sizeof(T));
+            _ocupados_ultimo_bloco = restantes;
+        }
+
+        _capacidade_diretorio = 16;
+        while (_capacidade_diretorio < _blocos.size())
+        {
+            _capacidade_diretorio *= 2;
+        }
+        publica_diretorio();
+    }
+
+    // Troca o conteudo com outra arena, sem copiar objetos. Nao pode ser chamado com
+    // leitores concorrentes
+    void troca(arena& outra)
+    {
+        std::swap(_blocos, outra._blocos);
+        std::swap(_alocados, outra._alocados);
+        std::swap(_dono_externo, outra._dono_externo);
+        std::swap(_ocupados_ultimo_bloco, outra._ocupados_ultimo_bloco);
+        std::swap(_diretorios, outra._diretorios);
+        std::swap(_capacidade_diretorio, outra._capacidade_diretorio);
+        std::swap(_bytes_diretorios, outra._bytes_diretorios);
+
+        celula** diretorio = _diretorio.load(std::memory_order_relaxed);
+        _diretorio.store(outra._diretorio.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        outra._diretorio.store(diretorio, std::memory_order_relaxed);
+    }
+
+    // Novos blocos nao movem os anteriores, entao referencias obtidas aqui seguem validas
+    T& operator[](size_t i)
+    {
+        return *reinterpret_cast<T*>(&_blocos[i / objetos_por_bloco][i % objetos_por_bloco]);
+    }
+    // Pode ser chamado por leitores concorrentes a cria(), com indices ja publicados
+    const T& operator[](size_t i) const
+    {
+        celula* const* diretorio = _diretorio.load(std::memory_order_acquire);
+        return *reinterpret_cast<const T*>(&diretorio[i / objetos_por_bloco][i % objetos_por_bloco]);
+    }
+
+    size_t tamanho() const
+    {
+        return _blocos.empty() ? 0 : (_blocos.size() - 1) * objetos_por_bloco + _ocupados_ultimo_bloco;
+    }
+
+    // Memoria que a arena alocou: blocos inteiros, mesmo se ainda vazios, e diretorios
+    size_t bytes_alocados() const
+    {
+        return _alocados.size() * objetos_por_bloco * sizeof(celula) + _bytes_diretorios;
+    }
+
+    // Memoria adotada (vide adota), que pertence a outro dono
+    size_t bytes_adotados() const
+    {
+        return (_blocos.size() - _alocados.size()) * objetos_por_bloco * sizeof(celula);
+    }
+
+private:
+    using celula = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    void novo_bloco()
+    {
+        _alocados.emplace_back(new celula[objetos_por_bloco]);
+        _blocos.push_back(_alocados.back().get());
+        _ocupados_ultimo_bloco = 0;
+
+        // Diretorio cheio: o novo, com o dobro da capacidade, so eh publicado pronto
+        if (_blocos.size() > _capacidade_diretorio)
+        {
+            _capacidade_diretorio = _capacidade_diretorio == 0 ? 16 : _capacidade_diretorio * 2;
+            publica_diretorio();
+        }
+        else
+        {
+            _diretorios.back()[_blocos.size() - 1] = _blocos.back();
+        }
+    }
+
+    void publica_diretorio()
+    {
+        std::unique_ptr<celula*[]> diretorio(new celula*[_capacidade_diretorio]);
+        for (size_t i = 0; i < _blocos.size(); i++)
+        {
+            diretorio[i] = _blocos[i];
+        }
+
+        _diretorio.store(diretorio.get(), std::memory_order_release);
+        _diretorios.push_back(std::move(diretorio));
+        _bytes_diretorios += _capacidade_diretorio * sizeof(celula*);
+    }
+
+    void destroi()
+    {
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            for (size_t i = 0; i < _blocos.size(); i++)
+            {
+                const size_t ocupados = i + 1 == _blocos.size() ? _ocupados_ultimo_bloco : objetos_por_bloco;
+                for (size_t j = 0; j < ocupados; j++)
+                {
+                    reinterpret_cast<T*>(&_blocos[i][j])->~T();
+                }
+            }
+        }
+    }
+
+    // Blocos em ordem, usados so por quem cria. Os alocados pela arena tem dono em
+    // _alocados; os adotados pertencem a _dono_externo
+    std::vector<celula*> _blocos;
+    std::vector<std::unique_ptr<celula[]>> _alocados;
+    std::shared_ptr<void> _dono_externo;
+    size_t _ocupados_ultimo_bloco = 0;
+
+    // Enderecos dos blocos, lidos pelas consultas. Diretorios substituidos continuam
+    // vivos ate a destruicao da arena (no maximo o dobro do atual, somados)
+    std::atomic<celula**> _diretorio { nullptr };
+    std::vector<std::unique_ptr<celula*[]>> _diretorios;
+    size_t _capacidade_diretorio = 0;
+    size_t _bytes_diretorios = 0;
+};
+
+}
+}
+}
+
+#endif // ARENA_H_
@@ -0,0 +1,224 @@
+/**
+ * @file copia_de_caminho.h
+ * @brief Motor de persistência por cópia de caminho (path copying).
+ *
+ * Nós de versões publicadas são imutáveis: a primeira escrita num nó de versão anterior o copia, e a
+ * cópia é religada ao pai, que também é copiado, até a raiz. Dentro da versão sendo escrita, os nós
+ * já copiados são alterados no lugar. Os nós não têm ponteiro para o pai nem histórico, então são
+ * menores e qualquer versão é lida sem resolver mods, em troca de O(log n) cópias por atualização.
+ */
+
+#ifndef COPIA_DE_CAMINHO_H_
+#define COPIA_DE_CAMINHO_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "persistencia/arena.h"
+#include "persistencia/definicoes.h"
+#include "persistencia/motor_por_caminho.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+template <typename chave_do_noh>
+class nohs_imutaveis
+{
+public:
+    using tipo_chave = chave_do_noh;
+
+    // Nohs alcancaveis de versoes publicadas nunca sao escritos
+    constexpr static const bool leitura_concorrente = true;
+
+    class noh
+    {
+        friend class nohs_imutaveis;
+
+    public:
+        noh() = default;
+        noh(const tipo_chave& chave, size_t versao) : _chave(chave), _versao(static_cast<uint32_t>(versao)) {}
+
+        // Um noh nunca muda depois que sua versao eh publicada, entao
+        // a versao lida nao importa
+        const tipo_chave& chave(size_t) const
+        {
+            return _chave;
+        }
+
+        indice esq(size_t) const
+        {
+            return _esq;
+        }
+
+        indice dir(size_t) const
+        {
+            return _dir;
+        }
+
+        cor_noh cor(size_t) const
+        {
+            return _cor;
+        }
+
+    private:
+        tipo_chave _chave = tipo_chave();
+        indice _esq = nulo;
+        indice _dir = nulo;
+
+        // Versao em que o noh foi criado, a unica em que pode ser escrito
+        uint32_t _versao = 0;
+        cor_noh _cor = cor_noh::rubro;
+    };
+
+    nohs_imutaveis()
+    {
+        // Reserva a posicao 0 da arena para o noh nulo
+        _nohs.cria();
+    }
+
+    const noh& obtem_noh(indice i) const
+    {
+        return _nohs[i];
+    }
+
+    // Identificacao e acesso aos nohs para salvar e carregar imagens (vide io/imagem.h)
+    static const char* nome()
+    {
+        return "copia_de_caminho";
+    }
+
+    size_t total_nohs() const
+    {
+        return _nohs.tamanho();
+    }
+
+    void adota(noh* nohs, size_t n, const std::shared_ptr<void>& dono)
+    {
+        _nohs.adota(nohs, n, dono);
+    }
+
+    // Sem mods: todo custo da persistencia sao copias
+    const custos_de_persistencia& custos() const
+    {
+        return _custos;
+    }
+
+    size_t bytes_alocados() const
+    {
+        return _nohs.bytes_alocados();
+    }
+
+    size_t bytes_adotados() const
+    {
+        return _nohs.bytes_adotados();
+    }
+
+    // Sem historico nos nohs, compactar eh so deixar para tras os que nao servem mais
+    void compacta(size_t, const std::vector<indice>& novo_indice)
+    {
+        arena<noh> compactada;
+        compactada.cria();
+        for (size_t i = 1; i < novo_indice.size(); i++)
+        {
+            if (novo_indice[i] != nulo)
+            {
+                noh copia = _nohs[i];
+                copia._esq = novo_indice[copia._esq];
+                copia._dir = novo_indice[copia._dir];
+                compactada.cria(copia);
+            }
+        }
+
+        _nohs.troca(compactada);
+    }
+
+    indice cria(const tipo_chave& chave, size_t versao)
+    {
+        return static_cast<indice>(_nohs.cria(chave, versao));
+    }
+
+    const tipo_chave& chave(indice n) const
+    {
+        return _nohs[n]._chave;
+    }
+
+    indice esq(indice n) const
+    {
+        return _nohs[n]._esq;
+    }
+
+    indice dir(indice n) const
+    {
+        return _nohs[n]._dir;
+    }
+
+    cor_noh cor(indice n) const
+    {
+        return _nohs[n]._cor;
+    }
+
+    indice grava(size_t nova_versao, indice n, campo c, uint32_t valor)
+    {
+        if (valor == le(n, c))
+        {
+            return n;
+        }
+
+        if (_nohs[n]._versao != nova_versao)
+        {
+            const auto copia = static_cast<indice>(_nohs.cria(_nohs[n]));
+            _nohs[copia]._versao = static_cast<uint32_t>(nova_versao);
+            n = copia;
+            _custos.copias++;
+        }
+
+        noh& x = _nohs[n];
+        if (c == campo::filho_esq)
+        {
+            x._esq = valor;
+        }
+        else if (c == campo::filho_dir)
+        {
+            x._dir = valor;
+        }
+        else
+        {
+            x._cor = static_cast<cor_noh>(valor);
+        }
+
+        return n;
+    }
+
+private:
+    uint32_t le(indice n, campo c) const
+    {
+        if (c == campo::filho_esq)
+        {
+            return _nohs[n]._esq;
+        }
+
+        if (c == campo::filho_dir)
+        {
+            return _nohs[n]._dir;
+        }
+
+        return static_cast<uint32_t>(_nohs[n]._cor);
+    }
+
+    arena<noh> _nohs;
+    custos_de_persistencia _custos;
+};
+
+template <typename tipo_chave, typename comparador>
+using copia_de_caminho = motor_por_caminho<nohs_imutaveis<tipo_chave>, comparador>;
+
+}
+}
+}
+
+#endif // COPIA_DE_CAMINHO_H_
@@ -0,0 +1,947 @@
+/**
+ * @file copia_de_nohs.h
+ * @brief Motor de persistência por cópia de nós (node copying) com ponteiros para o pai.
+ *
+ * Cada nó guarda diretamente os valores da versão mais recente e até 2p = 6 mods, que registram o
+ * valor que cada campo tinha antes de ser modificado. Quando os mods se esgotam, o nó é copiado e
+ * quem apontava para ele (pai e filhos) é avisado. Escritas e leituras da última versão não
+ * resolvem mods; só leituras de versões antigas percorrem o histórico do nó.
+ */
+
+#ifndef COPIA_DE_NOHS_H_
+#define COPIA_DE_NOHS_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "persistencia/arena.h"
+#include "persistencia/definicoes.h"
+#include "persistencia/instrumentacao.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+// Vide copia_de_nohs e copia_de_nohs_instrumentada, ao final
+template <typename tipo_chave, typename comparador, typename politica_de_instrumentacao>
+class copia_de_nohs_instrumentavel
+{
+public:
+    // As escritas mudam no lugar os campos de nohs que versoes publicadas enxergam
+    constexpr static const bool leitura_concorrente = false;
+
+    using instrumentacao = politica_de_instrumentacao;
+
+    class alignas(16) noh
+    {
+        friend class copia_de_nohs_instrumentavel;
+
+        // Os valores dos campos versionados indexam _slots_do_campo
+        constexpr static const size_t n_campos = 4;
+
+        struct mod
+        {
+            uint32_t versao;
+            uint32_t valor;
+        };
+
+    public:
+        noh() = default;
+        noh(const tipo_chave& chave, size_t versao) : _chave(chave), _versao_estavel(static_cast<uint32_t>(versao)) {}
+
+        // A chave nunca eh modificada depois de criada, nao ocupa mods
+        const tipo_chave& chave(size_t) const
+        {
+            return _chave;
+        }
+        const tipo_chave& chave() const
+        {
+            return _chave;
+        }
+
+        // Os campos do noh guardam sempre a visao da versao mais recente. Os mods
+        // guardam o valor anterior de cada modificacao, entao so leituras de versoes
+        // anteriores a ultima modificacao do noh precisam consulta-los
+        indice pai(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _pai : acessa_campo(campo::pai, versao);
+        }
+        indice pai() const
+        {
+            return _pai;
+        }
+
+        indice esq(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _esq : acessa_campo(campo::filho_esq, versao);
+        }
+        indice esq() const
+        {
+            return _esq;
+        }
+
+        indice dir(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _dir : acessa_campo(campo::filho_dir, versao);
+        }
+        indice dir() const
+        {
+            return _dir;
+        }
+
+        cor_noh cor(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _cor : static_cast<cor_noh>(acessa_campo(campo::cor, versao));
+        }
+        cor_noh cor() const
+        {
+            return _cor;
+        }
+
+    private:
+        // A copia ja nasce com os valores correntes, basta descartar o historico
+        void compacta(size_t versao)
+        {
+            _slots_do_campo = {};
+            _n_mods = 0;
+            _copia = nulo;
+            _versao_estavel = static_cast<uint32_t>(versao);
+        }
+
+        // Copia para a arena compactada (vide copia_de_nohs::compacta). Os mods de versoes
+        // ate o horizonte so guardam valores de versoes expiradas e sao descartados, o que
+        // libera slots. Os indices passam a ser os da nova arena
+        noh compactado(size_t horizonte, const std::vector<indice>& novo_indice) const
+        {
+            noh copia(*this);
+            copia._pai = novo_indice[_pai];
+            copia._esq = novo_indice[_esq];
+            copia._dir = novo_indice[_dir];
+            copia._copia = nulo;
+            copia._slots_do_campo = {};
+            copia._n_mods = 0;
+
+            for (uint8_t i = 0; i < _n_mods; i++)
+            {
+                if (mods[i].versao <= horizonte)
+                {
+                    continue;
+                }
+
+                size_t c = 0;
+                while ((_slots_do_campo[c] & (1u << i)) == 0)
+                {
+                    c++;
+                }
+
+                const uint32_t valor = c == static_cast<size_t>(campo::cor) ? mods[i].valor : novo_indice[mods[i].valor];
+                copia._slots_do_campo[c] |= static_cast<uint8_t>(1u << copia._n_mods);
+                copia.mods[copia._n_mods++] = { mods[i].versao, valor };
+            }
+
+            return copia;
+        }
+
+        // Os mods sao gravados em ordem crescente de versao. O valor do campo na
+        // versao eh o guardado pelo primeiro mod daquele campo feito depois dela,
+        // ou o valor corrente se o campo nao mudou desde entao
+        uint32_t acessa_campo(campo c, size_t versao) const
+        {
+            uint8_t slots = _slots_do_campo[static_cast<size_t>(c)];
+            unsigned lidos = 0;
+            while (slots != 0)
+            {
+                const int i = primeiro_slot(slots);
+                lidos++;
+                if (mods[i].versao > versao)
+                {
+                    instrumentacao::slots_lidos(lidos);
+                    return mods[i].valor;
+                }
+
+                slots &= static_cast<uint8_t>(~(1u << i));
+            }
+
+            instrumentacao::slots_lidos(lidos);
+            return acessa_campo(c);
+        }
+
+        uint32_t acessa_campo(campo c) const
+        {
+            if (c == campo::pai)
+            {
+                return _pai;
+            }
+
+            if (c == campo::filho_esq)
+            {
+                return _esq;
+            }
+
+            if (c == campo::filho_dir)
+            {
+                return _dir;
+            }
+
+            return static_cast<uint32_t>(_cor);
+        }
+
+        void modifica_campo(campo c, uint32_t valor)
+        {
+            if (c == campo::pai)
+            {
+                _pai = valor;
+            }
+            else if (c == campo::filho_esq)
+            {
+                _esq = valor;
+            }
+            else if (c == campo::filho_dir)
+            {
+                _dir = valor;
+            }
+            else
+            {
+                _cor = static_cast<cor_noh>(valor);
+            }
+        }
+
+        // Garante que o valor corrente do campo, anterior a nova versao, esta salvo
+        // antes de ser sobrescrito. Retorna false se nao ha mod livre para isso
+        bool preserva_campo(size_t nova_versao, campo c)
+        {
+            // Noh criado (ou copiado) nesta versao: nenhuma versao anterior o enxerga
+            if (_n_mods == 0 && _versao_estavel == nova_versao)
+            {
+                return true;
+            }
+
+            // O valor anterior a esta versao ja foi salvo numa escrita anterior
+            uint8_t& slots = _slots_do_campo[static_cast<size_t>(c)];
+            const int ultimo = ultimo_slot(slots);
+            if (ultimo >= 0 && mods[ultimo].versao == nova_versao)
+            {
+                return true;
+            }
+
+            if (_n_mods == mods.size())
+            {
+                instrumentacao::mod_recusado();
+                return false;
+            }
+
+            slots |= static_cast<uint8_t>(1u << _n_mods);
+            mods[_n_mods++] = { static_cast<uint32_t>(nova_versao), acessa_campo(c) };
+            _versao_estavel = static_cast<uint32_t>(nova_versao);
+
+            return true;
+        }
+
+        // Linha quente: tudo que uma descida le fica nos primeiros 16 bytes do noh (com
+        // chaves de ate 4 bytes), que, com o alinhamento de 16, nunca atravessam duas
+        // linhas de cache.
+        // Versoes a partir de _versao_estavel leem os campos diretamente
+        tipo_chave _chave = tipo_chave();
+        indice _esq = nulo;
+        indice _dir = nulo;
+        uint32_t _versao_estavel = 0;
+
+        indice _pai = nulo;
+        cor_noh _cor = cor_noh::rubro;
+
+        // Bit i ligado em _slots_do_campo[c] indica que mods[i] guarda o campo c
+        std::array<uint8_t, n_campos> _slots_do_campo = {};
+        uint8_t _n_mods = 0;
+
+        // Noh que substitui este quando os mods estouram. So eh seguido durante
+        // a escrita da versao em que a copia foi feita (vide copia_de_nohs::normaliza)
+        indice _copia = nulo;
+
+        // Numa ABB, um noh em particular pode ser apontado por no maximo
+        // outros 3 nohs: seu pai, seu filho esquerdo e seu filho direito
+        // Logo, p = 3. Numa estrutura persistente, guardamos 2p mods = 6 mods
+        std::array<noh::mod, 6> mods;
+    };
+
+    explicit copia_de_nohs_instrumentavel(balanceamento b) : _balanceamento(b)
+    {
+        // Reserva a posicao 0 da arena para o noh nulo
+        _nohs.cria();
+    }
+
+    const noh& obtem_noh(indice i) const
+    {
+        return _nohs[i];
+    }
+
+    // Estado completo, para imagens da arvore (vide io/imagem.h)
+    static const char* nome()
+    {
+        return "copia_de_nohs";
+    }
+
+    size_t total_nohs() const
+    {
+        return _nohs.tamanho();
+    }
+
+    void adota(noh* nohs, size_t n, const std::shared_ptr<void>& dono)
+    {
+        _nohs.adota(nohs, n, dono);
+    }
+
+    // Copias e mods desde a criacao (vide abb_persistente::custos_acumulados)
+    const custos_de_persistencia& custos() const
+    {
+        return _custos;
+    }
+
+    size_t bytes_alocados() const
+    {
+        return _nohs.bytes_alocados() + _tocados.capacity() * sizeof(indice);
+    }
+
+    size_t bytes_adotados() const
+    {
+        return _nohs.bytes_adotados();
+    }
+
+    // Refaz a arena so com os nohs que servem as versoes a partir do horizonte (vide
+    // abb_persistente::compacta). novo_indice leva cada indice ao da nova arena, ou a nulo
+    // se o noh nao serve mais, e preserva a ordem de criacao. Entre duas escritas, _copia
+    // nao eh mais seguida e pode ser descartada
+    void compacta(size_t horizonte, const std::vector<indice>& novo_indice)
+    {
+        arena<noh> compactada;
+        compactada.cria();
+        for (size_t i = 1; i < novo_indice.size(); i++)
+        {
+            if (novo_indice[i] != nulo)
+            {
+                compactada.cria(_nohs[i].compactado(horizonte, novo_indice));
+            }
+        }
+
+        _nohs.troca(compactada);
+    }
+
+    // Retorna a raiz da nova versao, criada a partir da raiz da anterior
+    indice inclui(size_t nova_versao, indice raiz, const tipo_chave& chave)
+    {
+        _raiz = raiz;
+
+        const auto z = static_cast<indice>(_nohs.cria(chave, nova_versao));
+
+        inclui(nova_versao, z);
+        normaliza(nova_versao);
+
+        return _raiz;
+    }
+
+    indice remove(size_t nova_versao, indice raiz, const tipo_chave& chave)
+    {
+        _raiz = raiz;
+
+        const indice z = busca(raiz, chave);
+        if (z != nulo)
+        {
+            remove(nova_versao, z);
+            normaliza(nova_versao);
+        }
+
+        return _raiz;
+    }
+
+    int profundidade(size_t versao, indice, const noh& n) const
+    {
+        int prof = 0;
+        for (indice x = n.pai(versao); x != nulo; x = _nohs[x].pai(versao))
+        {
+            prof++;
+        }
+
+        return prof;
+    }
+
+private:
+    bool rubro_negra() const
+    {
+        return _balanceamento == balanceamento::rubro_negro;
+    }
+
+    // Referencias:
+    // https://www.youtube.com/watch?v=f7sIuYI5M2Y
+    // https://www.youtube.com/watch?v=QA2wFn9nQU4
+    // Cormen et al., Introduction to Algorithms, cap. 13 (Red-Black Trees)
+
+    indice busca(indice x, const tipo_chave& chave) const
+    {
+        while (x != nulo && !_ordem.igual(_nohs[x].chave(), chave))
+        {
+            x = _ordem.menor(chave, _nohs[x].chave()) ? esq(x) : dir(x);
+        }
+
+        return x;
+    }
+
+    indice min(indice x) const
+    {
+        while (esq(x) != nulo)
+        {
+            x = esq(x);
+        }
+
+        return x;
+    }
+
+    // Apos uma copia, as escritas seguintes (sempre na versao mais recente)
+    // devem ir para o noh mais novo, mesmo que o chamador ainda segure o antigo
+    indice atual(indice n) const
+    {
+        while (_nohs[n]._copia != nulo)
+        {
+            n = _nohs[n]._copia;
+        }
+
+        return n;
+    }
+
+    bool mesmo_noh(indice a, indice b) const
+    {
+        return atual(a) == atual(b);
+    }
+
+    // Acessos feitos durante a escrita de uma nova versao. Leem sempre a visao
+    // corrente (os campos do noh), sem consultar mods. Os indices sao resolvidos
+    // antes, entao continuam corretos mesmo apos copias do noh
+    indice pai(indice n) const
+    {
+        return _nohs[atual(n)].pai();
+    }
+    void pai(size_t nova_versao, indice n, indice valor)
+    {
+        modifica_campo(nova_versao, n, campo::pai, atual(valor));
+    }
+
+    indice esq(indice n) const
+    {
+        return _nohs[atual(n)].esq();
+    }
+    void esq(size_t nova_versao, indice n, indice valor)
+    {
+        modifica_campo(nova_versao, n, campo::filho_esq, atual(valor));
+    }
+
+    indice dir(indice n) const
+    {
+        return _nohs[atual(n)].dir();
+    }
+    void dir(size_t nova_versao, indice n, indice valor)
+    {
+        modifica_campo(nova_versao, n, campo::filho_dir, atual(valor));
+    }
+
+    // Folhas nulas sao negras
+    cor_noh cor(indice n) const
+    {
+        return n != nulo ? _nohs[atual(n)].cor() : cor_noh::negro;
+    }
+    void cor(size_t nova_versao, indice n, cor_noh c)
+    {
+        modifica_campo(nova_versao, n, campo::cor, static_cast<uint32_t>(c));
+    }
+
+    void modifica_campo(size_t nova_versao, indice n, campo c, uint32_t valor)
+    {
+        n = atual(n);
+
+        const uint32_t anterior = _nohs[n].acessa_campo(c);
+        if (anterior == valor)
+        {
+            return;
+        }
+
+        if (c != campo::cor)
+        {
+            _tocados.push_back(n);
+            _tocados.push_back(anterior);
+            _tocados.push_back(valor);
+        }
+
+        const uint8_t mods_antes = _nohs[n]._n_mods;
+        if (_nohs[n].preserva_campo(nova_versao, c))
+        {
+            _custos.mods += _nohs[n]._n_mods - mods_antes;
+            _nohs[n].modifica_campo(c, valor);
+        }
+        else
+        {
+            // O noh antigo fica congelado com a visao anterior a nova versao
+            const indice novo_noh = copia_compacta(nova_versao, n);
+            _custos.copias++;
+            const vizinhanca antes = vizinhos(novo_noh);
+            _nohs[novo_noh].modifica_campo(c, valor);
+
+            _nohs[n]._copia = novo_noh;
+
+            // Os avisos podem copiar os vizinhos, que avisam os seus, e assim por diante
+            if (instrumentacao::ativa)
+            {
+                instrumentacao::aviso_em_cascata(++_avisos_em_andamento);
+            }
+
+            avisa_observadores(nova_versao, n, antes);
+            avisa_observadores(nova_versao, n, vizinhos(novo_noh));
+
+            if (instrumentacao::ativa)
+            {
+                _avisos_em_andamento--;
+            }
+        }
+    }
+
+    // Durante uma operacao, um noh pode ser copiado enquanto outro ainda aponta para
+    // ele sem ser seu pai ou filho nas vizinhancas avisadas (ex.: no meio de um
+    // transplante). Ao final, todo ponteiro de um noh tocado na versao eh resolvido,
+    // entao nenhum noh substituido fica alcancavel e leituras nunca seguem _copia
+    void normaliza(size_t nova_versao)
+    {
+        for (size_t i = 0; i < _tocados.size(); i++)
+        {
+            if (_tocados[i] == nulo)
+            {
+                continue;
+            }
+
+            const indice n = atual(_tocados[i]);
+            for (campo c : { campo::pai, campo::filho_esq, campo::filho_dir })
+            {
+                const indice valor = _nohs[n].acessa_campo(c);
+                if (valor != atual(valor))
+                {
+                    modifica_campo(nova_versao, n, c, atual(valor));
+                }
+            }
+        }
+
+        _tocados.clear();
+        raiz(raiz());
+    }
+
+    indice copia_compacta(size_t nova_versao, indice n)
+    {
+        // A copia sai da mesma arena, ao lado dos demais nohs tocados na versao
+        const auto copia = static_cast<indice>(_nohs.cria(_nohs[n]));
+        _nohs[copia].compacta(nova_versao);
+
+        return copia;
+    }
+
+    struct vizinhanca
+    {
+        indice pai;
+        indice esq;
+        indice dir;
+    };
+
+    vizinhanca vizinhos(indice n) const
+    {
+        return { _nohs[n].pai(), _nohs[n].esq(), _nohs[n].dir() };
+    }
+
+    // Avisa quem ainda aponta para o noh antigo (ja substituido por sua copia) na
+    // versao corrente. Os vizinhos sao checados antes e depois do mod que causou a
+    // copia, pois durante uma rotacao eles nao necessariamente apontam de volta
+    void avisa_observadores(size_t nova_versao, indice antigo, const vizinhanca& v)
+    {
+        const indice copia = _nohs[antigo]._copia;
+
+        if (v.esq != nulo && pai(v.esq) == antigo)
+        {
+            pai(nova_versao, v.esq, copia);
+        }
+
+        if (v.dir != nulo && pai(v.dir) == antigo)
+        {
+            pai(nova_versao, v.dir, copia);
+        }
+
+        if (v.pai != nulo)
+        {
+            if (esq(v.pai) == antigo)
+            {
+                esq(nova_versao, v.pai, copia);
+            }
+            else if (dir(v.pai) == antigo)
+            {
+                dir(nova_versao, v.pai, copia);
+            }
+        }
+        else if (raiz() == antigo)
+        {
+            // Se o pai eh nulo, o noh pode ser raiz
+            // Precisa avisar a arvore tambem
+            raiz(copia);
+        }
+    }
+
+    void inclui(size_t nova_versao, indice z)
+    {
+        indice y = nulo;
+        indice x = raiz();
+        const tipo_chave& chave = _nohs[z].chave();
+
+        while (x != nulo)
+        {
+            y = x;
+            x = _ordem.menor(chave, _nohs[x].chave()) ? esq(x) : dir(x);
+        }
+
+        pai(nova_versao, z, y);
+        if (y == nulo)
+        {
+            raiz(z);
+        }
+        else if (_ordem.menor(chave, _nohs[y].chave())) {
+            esq(nova_versao, y, z);
+        }
+        else {
+            dir(nova_versao, y, z);
+        }
+
+        if (rubro_negra())
+        {
+            corrige_inclusao(nova_versao, z);
+        }
+    }
+
+    void corrige_inclusao(size_t nova_versao, indice z)
+    {
+        while (cor(pai(z)) == cor_noh::rubro)
+        {
+            indice p = pai(z);
+            const indice g = pai(p);
+
+            if (mesmo_noh(p, esq(g)))
+            {
+                const indice y = dir(g);
+                if (cor(y) == cor_noh::rubro)
+                {
+                    cor(nova_versao, p, cor_noh::negro);
+                    cor(nova_versao, y, cor_noh::negro);
+                    cor(nova_versao, g, cor_noh::rubro);
+                    z = g;
+                }
+                else
+                {
+                    if (mesmo_noh(z, dir(p)))
+                    {
+                        z = p;
+                        rotaciona_esq(nova_versao, z);
+                        p = pai(z);
+                    }
+
+                    cor(nova_versao, p, cor_noh::negro);
+                    cor(nova_versao, g, cor_noh::rubro);
+                    rotaciona_dir(nova_versao, g);
+                }
+            }
+            else
+            {
+                const indice y = esq(g);
+                if (cor(y) == cor_noh::rubro)
+                {
+                    cor(nova_versao, p, cor_noh::negro);
+                    cor(nova_versao, y, cor_noh::negro);
+                    cor(nova_versao, g, cor_noh::rubro);
+                    z = g;
+                }
+                else
+                {
+                    if (mesmo_noh(z, esq(p)))
+                    {
+                        z = p;
+                        rotaciona_dir(nova_versao, z);
+                        p = pai(z);
+                    }
+
+                    cor(nova_versao, p, cor_noh::negro);
+                    cor(nova_versao, g, cor_noh::rubro);
+                    rotaciona_esq(nova_versao, g);
+                }
+            }
+        }
+
+        const indice r = raiz();
+        if (cor(r) != cor_noh::negro)
+        {
+            cor(nova_versao, r, cor_noh::negro);
+        }
+    }
+
+    void remove(size_t nova_versao, indice z)
+    {
+        // Como na remocao da rubro-negra nao ha sentinela, o pai de x eh guardado
+        // a parte, ja que x pode ser nulo
+        indice y = z;
+        cor_noh cor_original_y = cor(y);
+        indice x = nulo;
+        indice x_pai = nulo;
+
+        if (esq(z) == nulo)
+        {
+            x = dir(z);
+            x_pai = pai(z);
+            transplanta(nova_versao, z, dir(z));
+        }
+        else if (dir(z) == nulo)
+        {
+            x = esq(z);
+            x_pai = pai(z);
+            transplanta(nova_versao, z, esq(z));
+        }
+        else
+        {
+            y = min(dir(z));
+            cor_original_y = cor(y);
+            x = dir(y);
+
+            if (mesmo_noh(pai(y), z))
+            {
+                x_pai = y;
+            }
+            else
+            {
+                x_pai = pai(y);
+                transplanta(nova_versao, y, dir(y));
+                dir(nova_versao, y, dir(z));
+                pai(nova_versao, dir(y), y);
+            }
+
+            transplanta(nova_versao, z, y);
+            esq(nova_versao, y, esq(z));
+            pai(nova_versao, esq(y), y);
+
+            if (rubro_negra() && cor(y) != cor(z))
+            {
+                cor(nova_versao, y, cor(z));
+            }
+        }
+
+        if (rubro_negra() && cor_original_y == cor_noh::negro)
+        {
+            corrige_remocao(nova_versao, x, x_pai);
+        }
+    }
+
+    void corrige_remocao(size_t nova_versao, indice x, indice x_pai)
+    {
+        while (x_pai != nulo && cor(x) == cor_noh::negro)
+        {
+            if (mesmo_noh(x, esq(x_pai)))
+            {
+                indice w = dir(x_pai);
+                if (cor(w) == cor_noh::rubro)
+                {
+                    cor(nova_versao, w, cor_noh::negro);
+                    cor(nova_versao, x_pai, cor_noh::rubro);
+                    rotaciona_esq(nova_versao, x_pai);
+                    w = dir(x_pai);
+                }
+
+                if (cor(esq(w)) == cor_noh::negro &&
+                    cor(dir(w)) == cor_noh::negro)
+                {
+                    cor(nova_versao, w, cor_noh::rubro);
+                    x = x_pai;
+                    x_pai = pai(x);
+                }
+                else
+                {
+                    if (cor(dir(w)) == cor_noh::negro)
+                    {
+                        cor(nova_versao, esq(w), cor_noh::negro);
+                        cor(nova_versao, w, cor_noh::rubro);
+                        rotaciona_dir(nova_versao, w);
+                        w = dir(x_pai);
+                    }
+
+                    cor(nova_versao, w, cor(x_pai));
+                    cor(nova_versao, x_pai, cor_noh::negro);
+                    cor(nova_versao, dir(w), cor_noh::negro);
+                    rotaciona_esq(nova_versao, x_pai);
+                    x = raiz();
+                    x_pai = nulo;
+                }
+            }
+            else
+            {
+                indice w = esq(x_pai);
+                if (cor(w) == cor_noh::rubro)
+                {
+                    cor(nova_versao, w, cor_noh::negro);
+                    cor(nova_versao, x_pai, cor_noh::rubro);
+                    rotaciona_dir(nova_versao, x_pai);
+                    w = esq(x_pai);
+                }
+
+                if (cor(esq(w)) == cor_noh::negro &&
+                    cor(dir(w)) == cor_noh::negro)
+                {
+                    cor(nova_versao, w, cor_noh::rubro);
+                    x = x_pai;
+                    x_pai = pai(x);
+                }
+                else
+                {
+                    if (cor(esq(w)) == cor_noh::negro)
+                    {
+                        cor(nova_versao, dir(w), cor_noh::negro);
+                        cor(nova_versao, w, cor_noh::rubro);
+                        rotaciona_esq(nova_versao, w);
+                        w = esq(x_pai);
+                    }
+
+                    cor(nova_versao, w, cor(x_pai));
+                    cor(nova_versao, x_pai, cor_noh::negro);
+                    cor(nova_versao, esq(w), cor_noh::negro);
+                    rotaciona_dir(nova_versao, x_pai);
+                    x = raiz();
+                    x_pai = nulo;
+                }
+            }
+        }
+
+        if (x != nulo && cor(x) != cor_noh::negro)
+        {
+            cor(nova_versao, x, cor_noh::negro);
+        }
+    }
+
+    void rotaciona_esq(size_t nova_versao, indice x)
+    {
+        const indice y = dir(x);
+
+        dir(nova_versao, x, esq(y));
+        if (esq(y) != nulo)
+        {
+            pai(nova_versao, esq(y), x);
+        }
+
+        pai(nova_versao, y, pai(x));
+        if (pai(x) == nulo)
+        {
+            raiz(y);
+        }
+        else if (mesmo_noh(x, esq(pai(x))))
+        {
+            esq(nova_versao, pai(x), y);
+        }
+        else
+        {
+            dir(nova_versao, pai(x), y);
+        }
+
+        esq(nova_versao, y, x);
+        pai(nova_versao, x, y);
+    }
+
+    void rotaciona_dir(size_t nova_versao, indice x)
+    {
+        const indice y = esq(x);
+
+        esq(nova_versao, x, dir(y));
+        if (dir(y) != nulo)
+        {
+            pai(nova_versao, dir(y), x);
+        }
+
+        pai(nova_versao, y, pai(x));
+        if (pai(x) == nulo)
+        {
+            raiz(y);
+        }
+        else if (mesmo_noh(x, dir(pai(x))))
+        {
+            dir(nova_versao, pai(x), y);
+        }
+        else
+        {
+            esq(nova_versao, pai(x), y);
+        }
+
+        dir(nova_versao, y, x);
+        pai(nova_versao, x, y);
+    }
+
+    void transplanta(size_t nova_versao, indice u, indice v)
+    {
+        if (u == nulo)
+        {
+            return;
+        }
+
+        if (pai(u) == nulo)
+        {
+            raiz(v);
+        }
+        else if (mesmo_noh(u, esq(pai(u))))
+        {
+            esq(nova_versao, pai(u), v);
+        }
+        else
+        {
+            dir(nova_versao, pai(u), v);
+        }
+
+        if (v != nulo)
+        {
+            pai(nova_versao, v, pai(u));
+        }
+    }
+
+    indice raiz() const
+    {
+        return _raiz;
+    }
+    void raiz(indice n)
+    {
+        _raiz = atual(n);
+    }
+
+    const balanceamento _balanceamento;
+    const ordem<tipo_chave, comparador> _ordem = {};
+
+    // Raiz da versao sendo escrita
+    indice _raiz = nulo;
+
+    // Dona de todos os nohs, inclusive das copias. Libera tudo de uma vez na destruicao
+    arena<noh> _nohs;
+
+    // Nohs escritos (e os que eles apontavam ou passaram a apontar) na versao corrente
+    std::vector<indice> _tocados;
+
+    custos_de_persistencia _custos;
+
+    // Copias cujos avisos ainda estao em andamento, so com instrumentacao
+    unsigned _avisos_em_andamento = 0;
+};
+
+template <typename tipo_chave, typename comparador>
+using copia_de_nohs = copia_de_nohs_instrumentavel<tipo_chave, comparador, sem_instrumentacao>;
+
+// Mesmo motor e mesmos nohs (inclusive nas imagens), contando o que acontece em cada
+// operacao (vide instrumentacao.h)
+template <typename tipo_chave, typename comparador>
+using copia_de_nohs_instrumentada = copia_de_nohs_instrumentavel<tipo_chave, comparador, instrumentacao_por_operacao>;
+
+}
+}
+}
+
+#endif // COPIA_DE_NOHS_H_
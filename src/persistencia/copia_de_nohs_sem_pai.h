@@ -0,0 +1,321 @@
+/**
+ * @file copia_de_nohs_sem_pai.h
+ * @brief Motor de persistência por cópia de nós (node copying) sem ponteiro para o pai.
+ *
+ * Sem o pai, cada nó é apontado apenas pelo seu pai na árvore (p = 1). A cópia de um nó só precisa
+ * religar o pai, o que o motor por caminho já faz ao subir pela pilha de ancestrais; nenhum filho
+ * gasta mods para trocar seu ponteiro de volta, o que reduz os mods por operação e a frequência de
+ * cópias em cascata. Profundidade e sucessor são calculados a partir da descida.
+ */
+
+#ifndef COPIA_DE_NOHS_SEM_PAI_H_
+#define COPIA_DE_NOHS_SEM_PAI_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "persistencia/arena.h"
+#include "persistencia/definicoes.h"
+#include "persistencia/motor_por_caminho.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+template <typename chave_do_noh>
+class nohs_sem_pai
+{
+public:
+    using tipo_chave = chave_do_noh;
+
+    // As escritas mudam no lugar os campos de nohs que versoes publicadas enxergam
+    constexpr static const bool leitura_concorrente = false;
+
+    class alignas(16) noh
+    {
+        friend class nohs_sem_pai;
+
+        constexpr static const size_t n_campos = 4;
+
+        struct mod
+        {
+            uint32_t versao;
+            uint32_t valor;
+        };
+
+    public:
+        noh() = default;
+        noh(const tipo_chave& chave, size_t versao) : _chave(chave), _versao_estavel(static_cast<uint32_t>(versao)) {}
+
+        const tipo_chave& chave(size_t) const
+        {
+            return _chave;
+        }
+
+        // Mesmo esquema de copia_de_nohs::noh: os campos guardam a ultima
+        // versao e os mods, os valores anteriores a cada modificacao
+        indice esq(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _esq : acessa_campo(campo::filho_esq, versao);
+        }
+
+        indice dir(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _dir : acessa_campo(campo::filho_dir, versao);
+        }
+
+        cor_noh cor(size_t versao) const
+        {
+            return versao >= _versao_estavel ? _cor : static_cast<cor_noh>(acessa_campo(campo::cor, versao));
+        }
+
+    private:
+        uint32_t acessa_campo(campo c, size_t versao) const
+        {
+            uint8_t slots = _slots_do_campo[static_cast<size_t>(c)];
+            while (slots != 0)
+            {
+                const int i = primeiro_slot(slots);
+                if (mods[i].versao > versao)
+                {
+                    return mods[i].valor;
+                }
+
+                slots &= static_cast<uint8_t>(~(1u << i));
+            }
+
+            return acessa_campo(c);
+        }
+
+        uint32_t acessa_campo(campo c) const
+        {
+            if (c == campo::filho_esq)
+            {
+                return _esq;
+            }
+
+            if (c == campo::filho_dir)
+            {
+                return _dir;
+            }
+
+            return static_cast<uint32_t>(_cor);
+        }
+
+        void modifica_campo(campo c, uint32_t valor)
+        {
+            if (c == campo::filho_esq)
+            {
+                _esq = valor;
+            }
+            else if (c == campo::filho_dir)
+            {
+                _dir = valor;
+            }
+            else
+            {
+                _cor = static_cast<cor_noh>(valor);
+            }
+        }
+
+        // Como em copia_de_nohs::noh::compactado
+        noh compactado(size_t horizonte, const std::vector<indice>& novo_indice) const
+        {
+            noh copia(*this);
+            copia._esq = novo_indice[_esq];
+            copia._dir = novo_indice[_dir];
+            copia._slots_do_campo = {};
+            copia._n_mods = 0;
+
+            for (uint8_t i = 0; i < _n_mods; i++)
+            {
+                if (mods[i].versao <= horizonte)
+                {
+                    continue;
+                }
+
+                size_t c = 0;
+                while ((_slots_do_campo[c] & (1u << i)) == 0)
+                {
+                    c++;
+                }
+
+                const uint32_t valor = c == static_cast<size_t>(campo::cor) ? mods[i].valor : novo_indice[mods[i].valor];
+                copia._slots_do_campo[c] |= static_cast<uint8_t>(1u << copia._n_mods);
+                copia.mods[copia._n_mods++] = { mods[i].versao, valor };
+            }
+
+            return copia;
+        }
+
+        // Retorna false se o valor anterior a nova versao precisaria de um mod e nao ha mod livre
+        bool preserva_campo(size_t nova_versao, campo c)
+        {
+            if (_n_mods == 0 && _versao_estavel == nova_versao)
+            {
+                return true;
+            }
+
+            uint8_t& slots = _slots_do_campo[static_cast<size_t>(c)];
+            const int ultimo = ultimo_slot(slots);
+            if (ultimo >= 0 && mods[ultimo].versao == nova_versao)
+            {
+                return true;
+            }
+
+            if (_n_mods == mods.size())
+            {
+                return false;
+            }
+
+            slots |= static_cast<uint8_t>(1u << _n_mods);
+            mods[_n_mods++] = { static_cast<uint32_t>(nova_versao), acessa_campo(c) };
+            _versao_estavel = static_cast<uint32_t>(nova_versao);
+
+            return true;
+        }
+
+        // Linha quente nos primeiros 16 bytes, como em copia_de_nohs::noh
+        tipo_chave _chave = tipo_chave();
+        indice _esq = nulo;
+        indice _dir = nulo;
+        uint32_t _versao_estavel = 0;
+
+        cor_noh _cor = cor_noh::rubro;
+        std::array<uint8_t, n_campos> _slots_do_campo = {};
+        uint8_t _n_mods = 0;
+
+        // Cada noh eh apontado so pelo pai (p = 1). Mais mods que os 2p minimos
+        // diminuem as copias, e com 5 o noh inteiro ocupa 64 bytes
+        std::array<noh::mod, 5> mods;
+    };
+
+    nohs_sem_pai()
+    {
+        // Reserva a posicao 0 da arena para o noh nulo
+        _nohs.cria();
+    }
+
+    const noh& obtem_noh(indice i) const
+    {
+        return _nohs[i];
+    }
+
+    // Usados por io/imagem.h
+    static const char* nome()
+    {
+        return "copia_de_nohs_sem_pai";
+    }
+
+    size_t total_nohs() const
+    {
+        return _nohs.tamanho();
+    }
+
+    void adota(noh* nohs, size_t n, const std::shared_ptr<void>& dono)
+    {
+        _nohs.adota(nohs, n, dono);
+    }
+
+    const custos_de_persistencia& custos() const
+    {
+        return _custos;
+    }
+
+    size_t bytes_alocados() const
+    {
+        return _nohs.bytes_alocados();
+    }
+
+    size_t bytes_adotados() const
+    {
+        return _nohs.bytes_adotados();
+    }
+
+    void compacta(size_t horizonte, const std::vector<indice>& novo_indice)
+    {
+        arena<noh> compactada;
+        compactada.cria();
+        for (size_t i = 1; i < novo_indice.size(); i++)
+        {
+            if (novo_indice[i] != nulo)
+            {
+                compactada.cria(_nohs[i].compactado(horizonte, novo_indice));
+            }
+        }
+
+        _nohs.troca(compactada);
+    }
+
+    indice cria(const tipo_chave& chave, size_t versao)
+    {
+        return static_cast<indice>(_nohs.cria(chave, versao));
+    }
+
+    const tipo_chave& chave(indice n) const
+    {
+        return _nohs[n]._chave;
+    }
+
+    indice esq(indice n) const
+    {
+        return _nohs[n]._esq;
+    }
+
+    indice dir(indice n) const
+    {
+        return _nohs[n]._dir;
+    }
+
+    cor_noh cor(indice n) const
+    {
+        return _nohs[n]._cor;
+    }
+
+    // Quando os mods se esgotam, a escrita vai para uma copia que nasce com
+    // os valores correntes e sem historico. O noh antigo fica congelado
+    indice grava(size_t nova_versao, indice n, campo c, uint32_t valor)
+    {
+        if (_nohs[n].acessa_campo(c) == valor)
+        {
+            return n;
+        }
+
+        const uint8_t mods_antes = _nohs[n]._n_mods;
+        if (!_nohs[n].preserva_campo(nova_versao, c))
+        {
+            const auto copia = static_cast<indice>(_nohs.cria(_nohs[n]._chave, nova_versao));
+            _nohs[copia]._esq = _nohs[n]._esq;
+            _nohs[copia]._dir = _nohs[n]._dir;
+            _nohs[copia]._cor = _nohs[n]._cor;
+            n = copia;
+            _custos.copias++;
+        }
+        else
+        {
+            _custos.mods += _nohs[n]._n_mods - mods_antes;
+        }
+
+        _nohs[n].modifica_campo(c, valor);
+
+        return n;
+    }
+
+private:
+    arena<noh> _nohs;
+    custos_de_persistencia _custos;
+};
+
+template <typename tipo_chave, typename comparador>
+using copia_de_nohs_sem_pai = motor_por_caminho<nohs_sem_pai<tipo_chave>, comparador>;
+
+}
+}
+}
+
+#endif // COPIA_DE_NOHS_SEM_PAI_H_
@@ -0,0 +1,136 @@
+/**
+ * @file definicoes.h
+ * @brief Tipos compartilhados pela árvore persistente e pelos seus motores de persistência.
+ *
+ * Os nós vivem em arenas e se referenciam por índices de 32 bits, o que também limita a quantidade
+ * de nós e de versões a 2^32 - 1. A posição 0 de toda arena é reservada para o nó nulo.
+ */
+
+#ifndef DEFINICOES_H_
+#define DEFINICOES_H_
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#define _MAXINT 2147483647
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+// Posicao de um noh na arena do motor. A posicao 0 eh reservada e representa o noh nulo
+using indice = uint32_t;
+constexpr static const indice nulo = 0;
+
+enum class balanceamento { nenhum, rubro_negro };
+enum class cor_noh : uint8_t { rubro, negro };
+
+// Campos de um noh que podem mudar de uma versao para outra (a chave eh imutavel)
+enum class campo : uint8_t { pai, filho_esq, filho_dir, cor };
+
+inline campo oposto(campo lado)
+{
+    return lado == campo::filho_esq ? campo::filho_dir : campo::filho_esq;
+}
+
+// O que a persistencia custou em uma ou mais versoes. Os motores contam copias e mods; a
+// arvore conta os nohs criados (inclusive as copias) e as versoes cuja raiz mudou
+struct custos_de_persistencia
+{
+    uint64_t nohs_criados = 0;
+    uint64_t copias = 0;
+    uint64_t mods = 0;
+    uint64_t raizes_trocadas = 0;
+
+    void soma(const custos_de_persistencia& outros)
+    {
+        nohs_criados += outros.nohs_criados;
+        copias += outros.copias;
+        mods += outros.mods;
+        raizes_trocadas += outros.raizes_trocadas;
+    }
+
+    // Campo a campo, o maior de cada um
+    void maximo(const custos_de_persistencia& outros)
+    {
+        nohs_criados = outros.nohs_criados > nohs_criados ? outros.nohs_criados : nohs_criados;
+        copias = outros.copias > copias ? outros.copias : copias;
+        mods = outros.mods > mods ? outros.mods : mods;
+        raizes_trocadas = outros.raizes_trocadas > raizes_trocadas ? outros.raizes_trocadas : raizes_trocadas;
+    }
+};
+
+// Comparacoes entre chaves, feitas somente pelo comparador da arvore (menor estrito).
+// Duas chaves sao iguais quando nenhuma eh menor que a outra
+template <typename tipo_chave, typename comparador, typename = void>
+class ordem
+{
+public:
+    bool menor(const tipo_chave& a, const tipo_chave& b) const
+    {
+        return _menor(a, b);
+    }
+
+    bool igual(const tipo_chave& a, const tipo_chave& b) const
+    {
+        return !_menor(a, b) && !_menor(b, a);
+    }
+
+private:
+    comparador _menor;
+};
+
+// Chaves inteiras com a ordem natural: passadas por valor e comparadas diretamente,
+// o mesmo codigo de quando a arvore so aceitava int
+template <typename tipo_chave>
+class ordem<tipo_chave, std::less<tipo_chave>, typename std::enable_if<std::is_integral<tipo_chave>::value>::type>
+{
+public:
+    bool menor(tipo_chave a, tipo_chave b) const
+    {
+        return a < b;
+    }
+
+    bool igual(tipo_chave a, tipo_chave b) const
+    {
+        return a == b;
+    }
+};
+
+// Mascaras de slots dos mods de um noh (ate 6): bit i ligado indica que o mod i guarda o campo
+
+// Indice do bit mais baixo ligado (slot mais antigo), -1 se nenhum
+inline int primeiro_slot(uint8_t slots)
+{
+    static const int8_t tabela[64] = {
+        -1, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+         4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+         5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+         4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+    };
+
+    return tabela[slots];
+}
+
+// Indice do bit mais alto ligado (slot mais recente), -1 se nenhum
+inline int ultimo_slot(uint8_t slots)
+{
+    static const int8_t tabela[64] = {
+        -1, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+         4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+         5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+         5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5
+    };
+
+    return tabela[slots];
+}
+
+}
+}
+}
+
+#endif // DEFINICOES_H_
@@ -0,0 +1,197 @@
+/**
+ * @file instrumentacao.h
+ * @brief Políticas de instrumentação do caminho quente dos nós, escolhidas em tempo de compilação.
+ *
+ * O motor chama a política nos pontos de interesse: slots de mods percorridos numa leitura de versão
+ * antiga, mods recusados por falta de slot livre (que forçam uma cópia) e profundidade dos avisos em
+ * cascata aos vizinhos de um nó copiado. A árvore avisa o fim de cada operação.
+ *
+ * `sem_instrumentacao` é a política padrão: todas as chamadas são vazias e somem na compilação, sem
+ * custo nem estado. `instrumentacao_por_operacao` soma os eventos de cada operação e, ao final dela,
+ * registra os totais em histogramas por tipo de operação, de modo que se vê a distribuição (e não só
+ * a média) de cada custo. Cada thread soma os eventos da sua operação corrente, e os histogramas são
+ * contadores atômicos, então consultas concorrentes não se misturam. Os histogramas são do processo
+ * inteiro, compartilhados por todas as árvores instrumentadas.
+ */
+
+#ifndef INSTRUMENTACAO_H_
+#define INSTRUMENTACAO_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+enum class operacao_instrumentada : uint8_t { inclusao, remocao, sucessor, percurso, profundidade };
+constexpr static const size_t n_operacoes_instrumentadas = 5;
+
+struct sem_instrumentacao
+{
+    constexpr static const bool ativa = false;
+
+    static void slots_lidos(unsigned) {}
+    static void mod_recusado() {}
+    static void aviso_em_cascata(unsigned) {}
+    static void conclui(operacao_instrumentada) {}
+};
+
+// Contagens em faixas de potencias de 2: a faixa 0 conta o valor 0, e a faixa i >= 1, os
+// valores em [2^(i-1), 2^i). A ultima faixa tambem conta todos os valores maiores. As
+// faixas cobrem ate latencias de minutos em nanossegundos
+class histograma
+{
+public:
+    constexpr static const size_t n_faixas = 40;
+
+    void registra(uint64_t valor)
+    {
+        _faixas[faixa(valor)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t contagem(size_t faixa) const
+    {
+        return _faixas[faixa].load(std::memory_order_relaxed);
+    }
+
+    uint64_t total() const
+    {
+        uint64_t t = 0;
+        for (size_t i = 0; i < n_faixas; i++)
+        {
+            t += contagem(i);
+        }
+
+        return t;
+    }
+
+    // Menor valor contado pela faixa
+    static uint64_t inicio_da_faixa(size_t faixa)
+    {
+        return faixa == 0 ? 0 : uint64_t(1) << (faixa - 1);
+    }
+
+    void zera()
+    {
+        for (std::atomic<uint64_t>& f : _faixas)
+        {
+            f.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static size_t faixa(uint64_t valor)
+    {
+        size_t f = 0;
+        while (valor != 0 && f + 1 < n_faixas)
+        {
+            valor >>= 1;
+            f++;
+        }
+
+        return f;
+    }
+
+    std::array<std::atomic<uint64_t>, n_faixas> _faixas {};
+};
+
+struct instrumentacao_por_operacao
+{
+    constexpr static const bool ativa = true;
+
+    // Distribuicao, por operacao, de cada custo
+    struct distribuicoes
+    {
+        histograma slots_lidos;
+        histograma mods_recusados;
+        histograma profundidade_da_cascata;
+    };
+
+    static void slots_lidos(unsigned n)
+    {
+        em_andamento().slots_lidos += n;
+    }
+
+    static void mod_recusado()
+    {
+        em_andamento().mods_recusados++;
+    }
+
+    static void aviso_em_cascata(unsigned profundidade)
+    {
+        contadores& c = em_andamento();
+        c.profundidade_da_cascata = profundidade > c.profundidade_da_cascata ? profundidade : c.profundidade_da_cascata;
+    }
+
+    static void conclui(operacao_instrumentada op)
+    {
+        contadores& c = em_andamento();
+        distribuicoes& d = todas()[static_cast<size_t>(op)];
+        d.slots_lidos.registra(c.slots_lidos);
+        d.mods_recusados.registra(c.mods_recusados);
+        d.profundidade_da_cascata.registra(c.profundidade_da_cascata);
+        c = contadores();
+    }
+
+    static const distribuicoes& de(operacao_instrumentada op)
+    {
+        return todas()[static_cast<size_t>(op)];
+    }
+
+    static void zera()
+    {
+        for (distribuicoes& d : todas())
+        {
+            d.slots_lidos.zera();
+            d.mods_recusados.zera();
+            d.profundidade_da_cascata.zera();
+        }
+        em_andamento() = contadores();
+    }
+
+private:
+    struct contadores
+    {
+        uint64_t slots_lidos = 0;
+        uint64_t mods_recusados = 0;
+        unsigned profundidade_da_cascata = 0;
+    };
+
+    static contadores& em_andamento()
+    {
+        thread_local contadores c;
+        return c;
+    }
+
+    static std::array<distribuicoes, n_operacoes_instrumentadas>& todas()
+    {
+        static std::array<distribuicoes, n_operacoes_instrumentadas> d;
+        return d;
+    }
+};
+
+// Politica de um motor: a que ele declara em `instrumentacao`, ou nenhuma
+template <typename motor, typename = void>
+struct instrumentacao_do_motor
+{
+    using tipo = sem_instrumentacao;
+};
+
+template <typename motor>
+struct instrumentacao_do_motor<motor, typename std::conditional<true, void, typename motor::instrumentacao>::type>
+{
+    using tipo = typename motor::instrumentacao;
+};
+
+}
+}
+}
+
+#endif // INSTRUMENTACAO_H_
@@ -0,0 +1,463 @@
+/**
+ * @file motor_por_caminho.h
+ * @brief Algoritmos de inclusão e remoção guiados pelo caminho da raiz até o nó, sem ponteiro para o pai.
+ *
+ * A descida guarda os ancestrais numa pilha explícita, e as correções da Árvore Rubro-Negra (Cormen
+ * et al., cap. 13) sobem por ela. A forma de persistir fica a cargo do armazém de nós: cada escrita
+ * devolve o nó que passou a guardar o novo valor, que pode ser uma cópia. Nesse caso, o pai no
+ * caminho é religado à cópia, o que pode, por sua vez, copiar o pai, e assim por diante até a raiz.
+ *
+ * O armazém deve oferecer `noh`, `obtem_noh`, `cria(chave, versao)`, as leituras correntes `chave`,
+ * `esq`, `dir` e `cor`, `grava(nova_versao, n, campo, valor)`, que retorna o índice do nó escrito,
+ * `leitura_concorrente`, `compacta`, `custos`, `bytes_alocados` e `bytes_adotados` (vide abb.h) e,
+ * para imagens, `nome`, `total_nohs` e `adota`.
+ */
+
+#ifndef MOTOR_POR_CAMINHO_H_
+#define MOTOR_POR_CAMINHO_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "persistencia/definicoes.h"
+
+namespace ufc
+{
+namespace eda
+{
+namespace persistencia
+{
+
+template <typename armazem, typename comparador>
+class motor_por_caminho
+{
+public:
+    using tipo_chave = typename armazem::tipo_chave;
+    using noh = typename armazem::noh;
+
+    constexpr static const bool leitura_concorrente = armazem::leitura_concorrente;
+
+    explicit motor_por_caminho(balanceamento b) : _balanceamento(b) {}
+
+    const noh& obtem_noh(indice i) const
+    {
+        return _nohs.obtem_noh(i);
+    }
+
+    static const char* nome()
+    {
+        return armazem::nome();
+    }
+
+    size_t total_nohs() const
+    {
+        return _nohs.total_nohs();
+    }
+
+    void adota(noh* nohs, size_t n, const std::shared_ptr<void>& dono)
+    {
+        _nohs.adota(nohs, n, dono);
+    }
+
+    const custos_de_persistencia& custos() const
+    {
+        return _nohs.custos();
+    }
+
+    size_t bytes_alocados() const
+    {
+        return _nohs.bytes_alocados() + _caminho.capacity() * sizeof(indice);
+    }
+
+    size_t bytes_adotados() const
+    {
+        return _nohs.bytes_adotados();
+    }
+
+    void compacta(size_t horizonte, const std::vector<indice>& novo_indice)
+    {
+        _nohs.compacta(horizonte, novo_indice);
+    }
+
+    // Retorna a raiz da nova versao, criada a partir da raiz da anterior
+    indice inclui(size_t nova_versao, indice raiz, const tipo_chave& chave)
+    {
+        inicia(nova_versao, raiz);
+
+        for (indice x = raiz; x != nulo; x = _ordem.menor(chave, _nohs.chave(x)) ? _nohs.esq(x) : _nohs.dir(x))
+        {
+            _caminho.push_back(x);
+        }
+
+        const indice z = _nohs.cria(chave, nova_versao);
+        if (_caminho.empty())
+        {
+            _raiz = z;
+        }
+        else
+        {
+            const size_t p = _caminho.size() - 1;
+            grava(p, _ordem.menor(chave, _nohs.chave(_caminho[p])) ? campo::filho_esq : campo::filho_dir, z);
+        }
+        _caminho.push_back(z);
+
+        if (rubro_negra())
+        {
+            corrige_inclusao();
+        }
+
+        return _raiz;
+    }
+
+    indice remove(size_t nova_versao, indice raiz, const tipo_chave& chave)
+    {
+        inicia(nova_versao, raiz);
+
+        indice z = raiz;
+        while (z != nulo && !_ordem.igual(_nohs.chave(z), chave))
+        {
+            _caminho.push_back(z);
+            z = _ordem.menor(chave, _nohs.chave(z)) ? _nohs.esq(z) : _nohs.dir(z);
+        }
+
+        if (z == nulo)
+        {
+            return _raiz;
+        }
+
+        _caminho.push_back(z);
+        const size_t pz = _caminho.size() - 1;
+
+        // x, o noh que ocupa o lugar do removido, eh sempre o filho lado_x do topo do caminho
+        // (ou a raiz, se o caminho esvaziar). Identificar x pelo pai evita ambiguidade com x nulo
+        campo lado_x = campo::filho_esq;
+        cor_noh cor_removida = cor(z);
+
+        if (_nohs.esq(z) == nulo || _nohs.dir(z) == nulo)
+        {
+            const indice x = _nohs.esq(z) != nulo ? _nohs.esq(z) : _nohs.dir(z);
+            if (pz > 0)
+            {
+                lado_x = lado(pz);
+            }
+
+            substitui(pz, x);
+            _caminho.pop_back();
+        }
+        else
+        {
+            // y, o menor da subarvore direita de z, assume o lugar de z
+            _caminho.push_back(_nohs.dir(z));
+            while (_nohs.esq(_caminho.back()) != nulo)
+            {
+                _caminho.push_back(_nohs.esq(_caminho.back()));
+            }
+
+            const size_t py = _caminho.size() - 1;
+            const indice y = _caminho[py];
+            cor_removida = cor(y);
+
+            indice novo_y = y;
+            if (py == pz + 1)
+            {
+                lado_x = campo::filho_dir;
+                _caminho.pop_back();
+            }
+            else
+            {
+                lado_x = campo::filho_esq;
+                substitui(py, _nohs.dir(y));
+                _caminho.pop_back();
+
+                novo_y = _nohs.grava(_versao, novo_y, campo::filho_dir, _nohs.dir(_caminho[pz]));
+            }
+
+            // y ja esta fora da versao corrente (ou so eh apontado por z), entao pode ser
+            // escrito solto e religado de uma vez no lugar de z
+            novo_y = _nohs.grava(_versao, novo_y, campo::filho_esq, _nohs.esq(_caminho[pz]));
+            novo_y = _nohs.grava(_versao, novo_y, campo::cor, static_cast<uint32_t>(cor(_caminho[pz])));
+            substitui(pz, novo_y);
+        }
+
+        if (rubro_negra() && cor_removida == cor_noh::negro)
+        {
+            corrige_remocao(lado_x);
+        }
+
+        return _raiz;
+    }
+
+    // Sem ponteiro para o pai, a profundidade eh a da descida ate o noh. Com chaves
+    // repetidas, iguais podem ficar dos dois lados, entao ambos sao procurados: o esquerdo
+    // primeiro, com o direito guardado numa pilha explicita, e nao na pilha de chamadas,
+    // que uma corrente de chaves iguais sem balanceamento estouraria
+    int profundidade(size_t versao, indice raiz, const noh& n) const
+    {
+        struct pendente
+        {
+            indice n;
+            int profundidade;
+        };
+
+        std::vector<pendente> pendentes;
+
+        indice x = raiz;
+        int prof = 0;
+        while (true)
+        {
+            if (x == nulo)
+            {
+                if (pendentes.empty())
+                {
+                    return -1;
+                }
+
+                x = pendentes.back().n;
+                prof = pendentes.back().profundidade;
+                pendentes.pop_back();
+                continue;
+            }
+
+            const noh& corrente = _nohs.obtem_noh(x);
+            if (&corrente == &n)
+            {
+                return prof;
+            }
+
+            prof++;
+            if (_ordem.menor(n.chave(versao), corrente.chave(versao)))
+            {
+                x = corrente.esq(versao);
+            }
+            else if (_ordem.menor(corrente.chave(versao), n.chave(versao)))
+            {
+                x = corrente.dir(versao);
+            }
+            else
+            {
+                pendentes.push_back({ corrente.dir(versao), prof });
+                x = corrente.esq(versao);
+            }
+        }
+    }
+
+private:
+    bool rubro_negra() const
+    {
+        return _balanceamento == balanceamento::rubro_negro;
+    }
+
+    void inicia(size_t nova_versao, indice raiz)
+    {
+        _versao = nova_versao;
+        _raiz = raiz;
+        _caminho.clear();
+    }
+
+    // Folhas nulas sao negras
+    cor_noh cor(indice n) const
+    {
+        return n != nulo ? _nohs.cor(n) : cor_noh::negro;
+    }
+
+    indice filho(indice n, campo lado) const
+    {
+        return lado == campo::filho_esq ? _nohs.esq(n) : _nohs.dir(n);
+    }
+
+    // Lado em que _caminho[k] esta pendurado no seu pai, _caminho[k - 1]
+    campo lado(size_t k) const
+    {
+        return _nohs.esq(_caminho[k - 1]) == _caminho[k] ? campo::filho_esq : campo::filho_dir;
+    }
+
+    // Escreve em _caminho[k]. Se o armazem devolver outro noh, ele toma o lugar do antigo
+    void grava(size_t k, campo c, uint32_t valor)
+    {
+        const indice novo = _nohs.grava(_versao, _caminho[k], c, valor);
+        if (novo != _caminho[k])
+        {
+            substitui(k, novo);
+        }
+    }
+
+    // Escreve no filho de _caminho[k], que nao precisa estar no caminho
+    void grava_filho(size_t k, campo lado, campo c, uint32_t valor)
+    {
+        const indice f = filho(_caminho[k], lado);
+        const indice novo = _nohs.grava(_versao, f, c, valor);
+        if (novo != f)
+        {
+            grava(k, lado, novo);
+        }
+    }
+
+    void grava(size_t k, campo c, cor_noh valor)
+    {
+        grava(k, c, static_cast<uint32_t>(valor));
+    }
+    void grava_filho(size_t k, campo lado, campo c, cor_noh valor)
+    {
+        grava_filho(k, lado, c, static_cast<uint32_t>(valor));
+    }
+
+    // Pendura novo no lugar de _caminho[k], que deve estar ligado ao seu pai
+    void substitui(size_t k, indice novo)
+    {
+        if (k == 0)
+        {
+            _raiz = novo;
+        }
+        else
+        {
+            grava(k - 1, lado(k), novo);
+        }
+
+        _caminho[k] = novo;
+    }
+
+    // O filho do lado dado sobe para a posicao k do caminho, e o noh rotacionado desce para k + 1.
+    // A ordem das escritas evita ciclos: x eh religado antes de y passar a apontar para ele,
+    // e y so eh pendurado no pai de x depois de pronto
+    void rotaciona(size_t k, campo lado_filho)
+    {
+        const campo lado_neto = oposto(lado_filho);
+        const indice y = filho(_caminho[k], lado_filho);
+
+        grava(k, lado_filho, filho(y, lado_neto));
+
+        const indice x = _caminho[k];
+        substitui(k, _nohs.grava(_versao, y, lado_neto, x));
+
+        _caminho.resize(k + 2);
+        _caminho[k + 1] = x;
+    }
+
+    void pinta_raiz_de_negro()
+    {
+        if (cor(_raiz) == cor_noh::rubro)
+        {
+            _raiz = _nohs.grava(_versao, _raiz, campo::cor, static_cast<uint32_t>(cor_noh::negro));
+        }
+    }
+
+    void corrige_inclusao()
+    {
+        // Um pai rubro nunca eh a raiz, entao z tem avo sempre que o laco executa
+        size_t z = _caminho.size() - 1;
+        while (z >= 2 && cor(_caminho[z - 1]) == cor_noh::rubro)
+        {
+            const size_t p = z - 1;
+            const size_t g = z - 2;
+            const campo lado_p = lado(p);
+            const campo lado_tio = oposto(lado_p);
+
+            if (cor(filho(_caminho[g], lado_tio)) == cor_noh::rubro)
+            {
+                grava(p, campo::cor, cor_noh::negro);
+                grava_filho(g, lado_tio, campo::cor, cor_noh::negro);
+                grava(g, campo::cor, cor_noh::rubro);
+
+                _caminho.resize(g + 1);
+                z = g;
+            }
+            else
+            {
+                if (lado(z) == lado_tio)
+                {
+                    // z sobe para o lugar do pai, que passa a ser o novo z
+                    rotaciona(p, lado_tio);
+                }
+
+                grava(p, campo::cor, cor_noh::negro);
+                grava(g, campo::cor, cor_noh::rubro);
+                rotaciona(g, lado_p);
+                break;
+            }
+        }
+
+        pinta_raiz_de_negro();
+    }
+
+    void corrige_remocao(campo lado_x)
+    {
+        while (!_caminho.empty())
+        {
+            size_t k = _caminho.size() - 1;
+            if (cor(filho(_caminho[k], lado_x)) != cor_noh::negro)
+            {
+                break;
+            }
+
+            const campo lado_w = oposto(lado_x);
+            if (cor(filho(_caminho[k], lado_w)) == cor_noh::rubro)
+            {
+                grava_filho(k, lado_w, campo::cor, cor_noh::negro);
+                grava(k, campo::cor, cor_noh::rubro);
+                rotaciona(k, lado_w);
+                k++;
+            }
+
+            const indice w = filho(_caminho[k], lado_w);
+            if (cor(filho(w, lado_x)) == cor_noh::negro && cor(filho(w, lado_w)) == cor_noh::negro)
+            {
+                grava_filho(k, lado_w, campo::cor, cor_noh::rubro);
+
+                // x sobe para o pai
+                if (k > 0)
+                {
+                    lado_x = lado(k);
+                }
+                _caminho.pop_back();
+
+                continue;
+            }
+
+            _caminho.push_back(w);
+            if (cor(filho(w, lado_w)) == cor_noh::negro)
+            {
+                grava_filho(k + 1, lado_x, campo::cor, cor_noh::negro);
+                grava(k + 1, campo::cor, cor_noh::rubro);
+                rotaciona(k + 1, lado_x);
+                _caminho.resize(k + 2);
+            }
+
+            grava(k + 1, campo::cor, cor(_caminho[k]));
+            grava_filho(k + 1, lado_w, campo::cor, cor_noh::negro);
+            _caminho.pop_back();
+
+            grava(k, campo::cor, cor_noh::negro);
+            rotaciona(k, lado_w);
+
+            // x passa a ser a raiz
+            _caminho.clear();
+        }
+
+        if (_caminho.empty())
+        {
+            pinta_raiz_de_negro();
+        }
+        else if (cor(filho(_caminho.back(), lado_x)) == cor_noh::rubro)
+        {
+            grava_filho(_caminho.size() - 1, lado_x, campo::cor, cor_noh::negro);
+        }
+    }
+
+    const balanceamento _balanceamento;
+    const ordem<tipo_chave, comparador> _ordem = {};
+
+    armazem _nohs;
+
+    // Estado da versao sendo escrita: sua raiz e os ancestrais do noh corrente,
+    // da raiz (posicao 0) ate ele. O vetor eh reaproveitado entre operacoes
+    size_t _versao = 0;
+    indice _raiz = nulo;
+    std::vector<indice> _caminho;
+};
+
+}
+}
+}
+
+#endif // MOTOR_POR_CAMINHO_H_
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
 #include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -147,3 +154,426 @@ TEST(abb_test, deve_ser_capaz_de_encontrar_sucessor_para_qualquer_versao)
     EXPECT_EQ(arvore->sucessor(3, 10), 5);
     EXPECT_EQ(arvore->sucessor(4, 10), 5);
 }
+
+TEST(abb_test, deve_imprimir_cores_quando_rubro_negra)
+{
+    // Exemplo de saida do SPEC.md
+    ufc::eda::persistencia::abb arvore { ufc::eda::persistencia::abb::balanceamento::rubro_negro };
+    arvore.inclui(50); // gera v1
+    arvore.inclui(42); // gera v2
+    arvore.inclui(65); // gera v3
+    arvore.inclui(13); // gera v4
+    arvore.inclui(52); // gera v5
+
+    EXPECT_STREQ(ufc::eda::io::utils::to_string(arvore, 1).c_str(), "50,0,N");
+    EXPECT_STREQ(ufc::eda::io::utils::to_string(arvore, 3).c_str(), "42,1,R 50,0,N 65,1,R");
+    EXPECT_STREQ(ufc::eda::io::utils::to_string(arvore, 5).c_str(), "13,2,R 42,1,N 50,0,N 52,2,R 65,1,N");
+}
+
+// Confere, na versao dada, se a raiz eh negra, se nenhum noh rubro tem pai rubro e
+// se todo caminho ate uma folha nula passa pelo mesmo numero de nohs negros
+bool eh_rubro_negra_valida(const ufc::eda::persistencia::abb& arvore, size_t versao)
+{
+    using abb = ufc::eda::persistencia::abb;
+
+    bool valida = true;
+    int altura_negra = -1;
+
+    arvore.visita_em_ordem(versao, [&](const abb::noh& x) {
+        const abb::indice pai = x.pai(versao);
+        if (pai == abb::nulo && x.cor(versao) != abb::cor_noh::negro)
+        {
+            valida = false;
+        }
+        if (pai != abb::nulo && x.cor(versao) == abb::cor_noh::rubro && arvore.obtem_noh(pai).cor(versao) == abb::cor_noh::rubro)
+        {
+            valida = false;
+        }
+
+        if (x.esq(versao) == abb::nulo || x.dir(versao) == abb::nulo)
+        {
+            int negros = x.cor(versao) == abb::cor_noh::negro ? 1 : 0;
+            for (abb::indice y = pai; y != abb::nulo; y = arvore.obtem_noh(y).pai(versao))
+            {
+                negros += arvore.obtem_noh(y).cor(versao) == abb::cor_noh::negro ? 1 : 0;
+            }
+
+            if (altura_negra == -1)
+            {
+                altura_negra = negros;
+            }
+            valida = valida && negros == altura_negra;
+        }
+    });
+
+    return valida;
+}
+
+TEST(abb_test, deve_manter_altura_logaritmica_com_inclusoes_ordenadas)
+{
+    ufc::eda::persistencia::abb arvore { ufc::eda::persistencia::abb::balanceamento::rubro_negro };
+
+    const int n = 1000;
+    for (int i = 0; i < n; i++)
+    {
+        arvore.inclui(i);
+    }
+
+    for (size_t versao = 1; versao <= arvore.ultima_versao(); versao += 97)
+    {
+        int profundidade_maxima = 0;
+        size_t total = 0;
+        arvore.visita_em_ordem(versao, [&](const ufc::eda::persistencia::abb::noh& x) {
+            profundidade_maxima = std::max(profundidade_maxima, arvore.profundidade(versao, x));
+            total++;
+        });
+
+        // Numa rubro-negra, h <= 2 * lg(n + 1)
+        EXPECT_EQ(total, versao);
+        EXPECT_LE(profundidade_maxima, 2 * std::log2(versao + 1));
+        EXPECT_TRUE(eh_rubro_negra_valida(arvore, versao));
+    }
+}
+
+TEST(abb_test, deve_preservar_versoes_antigas_com_rotacoes)
+{
+    // Compara cada versao com um std::multiset de referencia, ao longo de uma
+    // sequencia pseudo-aleatoria de inclusoes e remocoes com chaves repetidas
+    for (auto b : { ufc::eda::persistencia::abb::balanceamento::nenhum,
+                    ufc::eda::persistencia::abb::balanceamento::rubro_negro })
+    {
+        ufc::eda::persistencia::abb arvore { b };
+        std::vector<std::multiset<int>> referencias { {} };
+
+        std::mt19937 gerador(42);
+        std::uniform_int_distribution<int> chaves(0, 60);
+        for (int i = 0; i < 600; i++)
+        {
+            std::multiset<int> referencia = referencias.back();
+
+            const int chave = chaves(gerador);
+            if (gerador() % 3 == 0)
+            {
+                arvore.remove(chave);
+                auto it = referencia.find(chave);
+                if (it != referencia.end())
+                {
+                    referencia.erase(it);
+                }
+            }
+            else
+            {
+                arvore.inclui(chave);
+                referencia.insert(chave);
+            }
+
+            referencias.push_back(referencia);
+        }
+
+        for (size_t versao = 0; versao < referencias.size(); versao++)
+        {
+            std::vector<int> obtidas;
+            arvore.visita_em_ordem(versao, [&](const ufc::eda::persistencia::abb::noh& x) {
+                obtidas.push_back(x.chave(versao));
+            });
+
+            const std::multiset<int>& referencia = referencias[versao];
+            EXPECT_TRUE(std::equal(obtidas.begin(), obtidas.end(), referencia.begin(), referencia.end()));
+
+            for (int x = -1; x <= 61; x += 3)
+            {
+                auto it = referencia.upper_bound(x);
+                EXPECT_EQ(arvore.sucessor(x, versao), it != referencia.end() ? *it : _MAXINT);
+            }
+
+            if (arvore.rubro_negra())
+            {
+                EXPECT_TRUE(eh_rubro_negra_valida(arvore, versao));
+            }
+        }
+    }
+}
+
+TEST(abb_test, deve_manter_noh_compacto)
+{
+    // Chave e filhos na mesma linha de cache, referencias de 32 bits e nenhum
+    // ponteiro de volta para a arvore: o noh inteiro cabe em 80 bytes
+    EXPECT_LE(sizeof(ufc::eda::persistencia::abb::noh), 80u);
+    EXPECT_EQ(alignof(ufc::eda::persistencia::abb::noh) % 16, 0u);
+    EXPECT_EQ(sizeof(ufc::eda::persistencia::abb::indice), 4u);
+}
+
+TEST(abb_test, deve_percorrer_versao_degenerada_sem_recursao)
+{
+    // Inclusoes ordenadas sem balanceamento geram uma lista: a profundidade vem da
+    // descida, sem subir pelos pais, e a pilha explicita nao tem limite de recursao
+    ufc::eda::persistencia::abb arvore;
+
+    const int total = 10000;
+    for (int chave = 0; chave < total; chave++)
+    {
+        arvore.inclui(chave);
+    }
+
+    int visitados = 0;
+    bool profundidades_corretas = true;
+    arvore.percorre_em_ordem(arvore.ultima_versao(), [&](const ufc::eda::persistencia::abb::noh& x, int profundidade) {
+        profundidades_corretas = profundidades_corretas && profundidade == x.chave(arvore.ultima_versao());
+        visitados++;
+    });
+
+    EXPECT_EQ(visitados, total);
+    EXPECT_TRUE(profundidades_corretas);
+}
+
+TEST(abb_test, deve_aceitar_chaves_de_outros_tipos)
+{
+    {
+        // INT_MAX eh uma chave legitima: busca_sucessor distingue "sem sucessor" dela
+        ufc::eda::persistencia::abb arvore { ufc::eda::persistencia::abb::balanceamento::rubro_negro };
+        arvore.inclui(_MAXINT);
+
+        ASSERT_NE(arvore.busca_sucessor(0, 1), nullptr);
+        EXPECT_EQ(*arvore.busca_sucessor(0, 1), _MAXINT);
+        EXPECT_EQ(arvore.busca_sucessor(_MAXINT, 1), nullptr);
+    }
+    {
+        using abb64 = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs, int64_t>;
+        abb64 arvore { abb64::balanceamento::rubro_negro };
+
+        const int64_t grande = int64_t(1) << 40;
+        arvore.inclui(grande + 2);
+        arvore.inclui(grande);
+        arvore.inclui(-grande);
+
+        EXPECT_EQ(arvore.sucessor(0, 3), grande);
+        EXPECT_EQ(arvore.sucessor(grande, 3), grande + 2);
+        EXPECT_EQ(arvore.sucessor(grande + 2, 3), abb64::inf);
+        EXPECT_EQ(arvore.sucessor(0, 2), grande);
+        EXPECT_EQ(arvore.sucessor(-grande - 1, 2), grande);
+    }
+    {
+        // Chave composta (instante, id) em ordem decrescente de instante
+        using evento = std::pair<int64_t, int>;
+        struct mais_recente_primeiro
+        {
+            bool operator()(const evento& a, const evento& b) const
+            {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            }
+        };
+
+        using abb_eventos = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_sem_pai, evento, mais_recente_primeiro>;
+        abb_eventos arvore { abb_eventos::balanceamento::rubro_negro };
+
+        arvore.inclui({ 10, 1 });
+        arvore.inclui({ 30, 2 });
+        arvore.inclui({ 20, 3 });
+        arvore.inclui({ 30, 1 });
+        arvore.remove({ 20, 3 });
+
+        std::vector<evento> ordem;
+        arvore.percorre_em_ordem(4, [&](const abb_eventos::noh& x, int) { ordem.push_back(x.chave(4)); });
+        EXPECT_EQ(ordem, (std::vector<evento> { { 30, 1 }, { 30, 2 }, { 20, 3 }, { 10, 1 } }));
+
+        const evento* proximo = arvore.busca_sucessor({ 30, 2 }, 5);
+        ASSERT_NE(proximo, nullptr);
+        EXPECT_EQ(*proximo, evento(10, 1));
+        EXPECT_EQ(arvore.busca_sucessor({ 10, 1 }, 5), nullptr);
+    }
+}
+
+template <typename abb>
+void deve_reter_as_ultimas_versoes()
+{
+    for (auto b : { abb::balanceamento::nenhum, abb::balanceamento::rubro_negro })
+    {
+        const size_t retidas = 300;
+
+        abb com_retencao { b };
+        abb completa { b };
+        com_retencao.retem_ultimas_versoes(retidas);
+
+        // Tantas remocoes quanto inclusoes: o tamanho da arvore fica limitado
+        std::mt19937 gerador(17);
+        std::uniform_int_distribution<int> chaves(0, 200);
+        size_t maximo_nohs = 0;
+        for (int i = 1; i <= 40000; i++)
+        {
+            const int chave = chaves(gerador);
+            if (gerador() % 2 == 0)
+            {
+                com_retencao.remove(chave);
+                completa.remove(chave);
+            }
+            else
+            {
+                com_retencao.inclui(chave);
+                completa.inclui(chave);
+            }
+            maximo_nohs = std::max(maximo_nohs, com_retencao.total_nohs());
+
+            if (i % 20000 != 0)
+            {
+                continue;
+            }
+
+            const size_t ultima = completa.ultima_versao();
+            ASSERT_EQ(com_retencao.primeira_versao(), ultima - retidas + 1);
+            for (size_t versao = ultima - retidas + 1; versao <= ultima; versao += 3)
+            {
+                ASSERT_EQ(ufc::eda::io::utils::to_string(com_retencao, versao), ufc::eda::io::utils::to_string(completa, versao));
+                for (int x = -1; x <= 201; x += 20)
+                {
+                    ASSERT_EQ(com_retencao.sucessor(x, versao), completa.sucessor(x, versao));
+                }
+            }
+
+            // Versoes expiradas sao lidas como a primeira retida
+            EXPECT_EQ(ufc::eda::io::utils::to_string(com_retencao, 1),
+                      ufc::eda::io::utils::to_string(completa, ultima - retidas + 1));
+        }
+
+        // A memoria fica limitada pelas versoes retidas, e nao pelo historico
+        EXPECT_LT(maximo_nohs * 4, completa.total_nohs());
+    }
+}
+
+TEST(abb_test, deve_reter_as_ultimas_versoes_e_liberar_as_expiradas)
+{
+    deve_reter_as_ultimas_versoes<ufc::eda::persistencia::abb>();
+    deve_reter_as_ultimas_versoes<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_caminho>>();
+    deve_reter_as_ultimas_versoes<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_sem_pai>>();
+}
+
+TEST(abb_test, deve_reter_as_versoes_a_partir_de_uma_versao)
+{
+    ufc::eda::persistencia::abb com_retencao { ufc::eda::persistencia::abb::balanceamento::rubro_negro };
+    ufc::eda::persistencia::abb completa { ufc::eda::persistencia::abb::balanceamento::rubro_negro };
+    com_retencao.retem_a_partir_da_versao(2500);
+
+    for (int i = 0; i < 3000; i++)
+    {
+        com_retencao.inclui((i * 37) % 1000);
+        completa.inclui((i * 37) % 1000);
+    }
+
+    com_retencao.compacta();
+    EXPECT_EQ(com_retencao.primeira_versao(), 2500u);
+    EXPECT_LT(com_retencao.total_nohs(), completa.total_nohs());
+
+    for (int i = 0; i < 500; i++)
+    {
+        com_retencao.remove((i * 37) % 1000);
+        completa.remove((i * 37) % 1000);
+    }
+
+    for (size_t versao = 2500; versao <= completa.ultima_versao(); versao += 7)
+    {
+        EXPECT_EQ(ufc::eda::io::utils::to_string(com_retencao, versao), ufc::eda::io::utils::to_string(completa, versao));
+    }
+}
+
+template <typename abb>
+ufc::eda::persistencia::custos_de_persistencia deve_contar_os_custos()
+{
+    abb arvore { abb::balanceamento::rubro_negro };
+
+    ufc::eda::persistencia::custos_de_persistencia somados;
+    ufc::eda::persistencia::custos_de_persistencia maximo;
+    for (int i = 0; i < 3000; i++)
+    {
+        if (i % 4 == 3)
+        {
+            arvore.remove((i * 7919) % 1000);
+        }
+        else
+        {
+            arvore.inclui((i * 7919) % 1000);
+        }
+
+        somados.soma(arvore.custos_da_ultima_versao());
+        maximo.maximo(arvore.custos_da_ultima_versao());
+        EXPECT_LE(arvore.custos_da_ultima_versao().raizes_trocadas, 1u);
+    }
+
+    const ufc::eda::persistencia::custos_de_persistencia& acumulados = arvore.custos_acumulados();
+    EXPECT_EQ(acumulados.nohs_criados, somados.nohs_criados);
+    EXPECT_EQ(acumulados.copias, somados.copias);
+    EXPECT_EQ(acumulados.mods, somados.mods);
+    EXPECT_EQ(acumulados.raizes_trocadas, somados.raizes_trocadas);
+    EXPECT_EQ(arvore.maximo_por_versao().copias, maximo.copias);
+    EXPECT_EQ(arvore.maximo_por_versao().nohs_criados, maximo.nohs_criados);
+
+    // Sem retencao, nenhum noh criado deixa de ser guardado
+    EXPECT_EQ(acumulados.nohs_criados, arvore.nohs_vivos());
+    EXPECT_LE(acumulados.copias, acumulados.nohs_criados);
+    EXPECT_GT(acumulados.raizes_trocadas, 0u);
+    EXPECT_LE(acumulados.raizes_trocadas, arvore.ultima_versao());
+    EXPECT_GE(arvore.bytes_alocados(), arvore.nohs_vivos() * sizeof(typename abb::noh));
+    EXPECT_EQ(arvore.bytes_adotados(), 0u);
+
+    return acumulados;
+}
+
+TEST(abb_test, deve_contar_os_custos_da_persistencia)
+{
+    // Copia de nohs paga com mods e so copia quando eles se esgotam
+    const auto nohs = deve_contar_os_custos<ufc::eda::persistencia::abb>();
+    EXPECT_GT(nohs.mods, nohs.copias);
+
+    const auto sem_pai = deve_contar_os_custos<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_sem_pai>>();
+    EXPECT_GT(sem_pai.mods, 0u);
+
+    // Copia de caminho nao tem mods: toda escrita numa versao publicada eh uma copia
+    const auto caminho = deve_contar_os_custos<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_caminho>>();
+    EXPECT_EQ(caminho.mods, 0u);
+    EXPECT_GT(caminho.copias, nohs.copias);
+}
+
+TEST(abb_test, deve_instrumentar_o_caminho_quente_so_quando_pedido)
+{
+    using ufc::eda::persistencia::operacao_instrumentada;
+    using politica = ufc::eda::persistencia::instrumentacao_por_operacao;
+    using abb_instrumentada = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_instrumentada>;
+
+    // Os mesmos nohs, com ou sem instrumentacao
+    static_assert(sizeof(abb_instrumentada::noh) == sizeof(ufc::eda::persistencia::abb::noh), "");
+    static_assert(!ufc::eda::persistencia::abb::instrumentacao::ativa, "");
+    static_assert(abb_instrumentada::instrumentacao::ativa, "");
+
+    politica::zera();
+    abb_instrumentada arvore { abb_instrumentada::balanceamento::rubro_negro };
+    for (int i = 0; i < 500; i++)
+    {
+        arvore.inclui(i);
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        arvore.remove(i * 3);
+    }
+    for (size_t versao = 0; versao <= arvore.ultima_versao(); versao += 10)
+    {
+        arvore.sucessor(250, versao);
+    }
+    ufc::eda::io::utils::to_string(arvore, 300);
+
+    const politica::distribuicoes& inclusoes = politica::de(operacao_instrumentada::inclusao);
+    EXPECT_EQ(inclusoes.slots_lidos.total(), 500u);
+    EXPECT_EQ(inclusoes.mods_recusados.total(), 500u);
+    EXPECT_EQ(politica::de(operacao_instrumentada::remocao).mods_recusados.total(), 100u);
+    EXPECT_EQ(politica::de(operacao_instrumentada::sucessor).slots_lidos.total(), 61u);
+    EXPECT_EQ(politica::de(operacao_instrumentada::percurso).slots_lidos.total(), 1u);
+
+    // Inclusoes ordenadas esgotam mods, e as copias avisam os vizinhos
+    ASSERT_GT(arvore.custos_acumulados().copias, 0u);
+    EXPECT_LT(inclusoes.mods_recusados.contagem(0), 500u);
+    EXPECT_LT(inclusoes.profundidade_da_cascata.contagem(0), 500u);
+
+    // Versoes antigas sao lidas pelos mods
+    const ufc::eda::persistencia::histograma& sucessores = politica::de(operacao_instrumentada::sucessor).slots_lidos;
+    EXPECT_LT(sucessores.contagem(0), sucessores.total());
+
+    EXPECT_NE(ufc::eda::io::utils::custos_em_json(arvore).find("\"instrumentacao\""), std::string::npos);
+    EXPECT_EQ(ufc::eda::io::utils::custos_em_json(ufc::eda::persistencia::abb()).find("\"instrumentacao\""), std::string::npos);
+}
@@ -0,0 +1,47 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persistencia/arena.h"
+
+struct contador_destrutor
+{
+    contador_destrutor(int valor, int& destruidos) : valor(valor), destruidos(destruidos) {}
+    ~contador_destrutor() { destruidos++; }
+
+    int valor;
+    int& destruidos;
+};
+
+TEST(arena_test, deve_alocar_em_blocos_e_destruir_tudo_ao_final)
+{
+    int destruidos = 0;
+    {
+        ufc::eda::persistencia::arena<contador_destrutor, 8> a;
+
+        std::vector<contador_destrutor*> objetos;
+        for (int i = 0; i < 20; i++)
+        {
+            const size_t indice = a.cria(i, destruidos);
+            EXPECT_EQ(indice, static_cast<size_t>(i));
+            objetos.push_back(&a[indice]);
+        }
+
+        EXPECT_EQ(a.tamanho(), 20u);
+
+        // Dentro de um mesmo bloco, os objetos ficam contiguos
+        EXPECT_EQ(objetos[1], objetos[0] + 1);
+        EXPECT_EQ(objetos[7], objetos[0] + 7);
+
+        // Novos blocos nao invalidam os enderecos ja entregues
+        for (int i = 0; i < 20; i++)
+        {
+            EXPECT_EQ(objetos[i]->valor, i);
+            EXPECT_EQ(&a[i], objetos[i]);
+        }
+
+        EXPECT_EQ(destruidos, 0);
+    }
+
+    EXPECT_EQ(destruidos, 20);
+}
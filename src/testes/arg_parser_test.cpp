@@ -263,3 +263,91 @@ TEST(arg_parser_test, deve_ser_capaz_de_validar_argumentos)
         EXPECT_STREQ(arg_parser.arquivo_saida().c_str(), "");
     }
 }
+
+TEST(arg_parser_test, deve_separar_as_opcoes_dos_arquivos)
+{
+    {
+        // OK, opcoes em qualquer posicao apos o executavel
+        ufc::eda::io::arg_parser arg_parser;
+        arg_parser.adiciona("/usr/bin/cli");
+        arg_parser.adiciona("--carrega-imagem=antes.bin");
+        arg_parser.adiciona("entrada");
+        arg_parser.adiciona("saida");
+        arg_parser.adiciona("--salva-imagem=depois.bin");
+        const auto status = arg_parser.parse();
+
+        EXPECT_TRUE(status == ufc::eda::io::arg_parser::status::SUCESSO);
+        EXPECT_STREQ(arg_parser.arquivo_entrada().c_str(), "entrada.txt");
+        EXPECT_STREQ(arg_parser.arquivo_saida().c_str(), "saida.txt");
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_CARREGA_IMAGEM).c_str(), "antes.bin");
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_SALVA_IMAGEM).c_str(), "depois.bin");
+    }
+    {
+        // OK, opcao ausente fica vazia
+        ufc::eda::io::arg_parser arg_parser;
+        arg_parser.adiciona("/usr/bin/cli");
+        arg_parser.adiciona("entrada");
+        arg_parser.adiciona("saida");
+        const auto status = arg_parser.parse();
+
+        EXPECT_TRUE(status == ufc::eda::io::arg_parser::status::SUCESSO);
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_CARREGA_IMAGEM).c_str(), "");
+    }
+    {
+        // OK, diario com sincronizacao em grupo
+        ufc::eda::io::arg_parser arg_parser;
+        arg_parser.adiciona("/usr/bin/cli");
+        arg_parser.adiciona("entrada");
+        arg_parser.adiciona("saida");
+        arg_parser.adiciona("--diario=diario.bin");
+        arg_parser.adiciona("--sincroniza-a-cada=256");
+        const auto status = arg_parser.parse();
+
+        EXPECT_TRUE(status == ufc::eda::io::arg_parser::status::SUCESSO);
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_DIARIO).c_str(), "diario.bin");
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_SINCRONIZA_A_CADA).c_str(), "256");
+    }
+    {
+        // OK, retencao das ultimas versoes, custos e estatisticas
+        ufc::eda::io::arg_parser arg_parser;
+        arg_parser.adiciona("/usr/bin/cli");
+        arg_parser.adiciona("entrada");
+        arg_parser.adiciona("saida");
+        arg_parser.adiciona("--retem-versoes=1000");
+        arg_parser.adiciona("--custos=custos.json");
+        arg_parser.adiciona("--estatisticas=estatisticas.json");
+        const auto status = arg_parser.parse();
+
+        EXPECT_TRUE(status == ufc::eda::io::arg_parser::status::SUCESSO);
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_RETEM_VERSOES).c_str(), "1000");
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_CUSTOS).c_str(), "custos.json");
+        EXPECT_STREQ(arg_parser.opcao(ufc::eda::io::arg_parser::OPCAO_ESTATISTICAS).c_str(), "estatisticas.json");
+    }
+    for (const char* invalida : { "--desconhecida=x", "--salva-imagem", "--salva-imagem=", "--sincroniza-a-cada=-1",
+                                  "--sincroniza-a-cada=1k", "--sincroniza-a-cada=9999999999",
+                                  "--retem-versoes=", "--retem-versoes=ultimas", "--estatisticas=" })
+    {
+        // ERRO, opcao desconhecida, sem valor ou com valor invalido
+        ufc::eda::io::arg_parser arg_parser;
+        arg_parser.adiciona("/usr/bin/cli");
+        arg_parser.adiciona("entrada");
+        arg_parser.adiciona("saida");
+        arg_parser.adiciona(invalida);
+        const auto status = arg_parser.parse();
+
+        EXPECT_TRUE(status == ufc::eda::io::arg_parser::status::OPCAO_INVALIDA);
+        EXPECT_STREQ(arg_parser.arquivo_entrada().c_str(), "");
+    }
+    {
+        // ERRO, opcao repetida
+        ufc::eda::io::arg_parser arg_parser;
+        arg_parser.adiciona("/usr/bin/cli");
+        arg_parser.adiciona("entrada");
+        arg_parser.adiciona("saida");
+        arg_parser.adiciona("--salva-imagem=a.bin");
+        arg_parser.adiciona("--salva-imagem=b.bin");
+        const auto status = arg_parser.parse();
+
+        EXPECT_TRUE(status == ufc::eda::io::arg_parser::status::OPCAO_INVALIDA);
+    }
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "io/utils.h"
+#include "persistencia/abb.h"
+
+using abb_caminho = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_caminho>;
+
+// Os motores sem pai aplicam os mesmos algoritmos da copia de nohs, e a profundidade e o
+// sucessor vem da descida; toda versao deve ter a mesma forma e as mesmas respostas
+template <typename abb>
+void deve_imprimir_como_a_copia_de_nohs(unsigned semente)
+{
+    for (auto b : { abb::balanceamento::nenhum, abb::balanceamento::rubro_negro })
+    {
+        abb arvore { b };
+        ufc::eda::persistencia::abb por_nohs { b };
+
+        std::mt19937 gerador(semente);
+        std::uniform_int_distribution<int> chaves(0, 40);
+        for (int i = 0; i < 500; i++)
+        {
+            const int chave = chaves(gerador);
+            if (gerador() % 3 == 0)
+            {
+                arvore.remove(chave);
+                por_nohs.remove(chave);
+            }
+            else
+            {
+                arvore.inclui(chave);
+                por_nohs.inclui(chave);
+            }
+        }
+
+        for (size_t versao = 0; versao <= por_nohs.ultima_versao(); versao++)
+        {
+            EXPECT_EQ(ufc::eda::io::utils::to_string(arvore, versao), ufc::eda::io::utils::to_string(por_nohs, versao));
+            for (int x = -1; x <= 41; x += 3)
+            {
+                EXPECT_EQ(arvore.sucessor(x, versao), por_nohs.sucessor(x, versao));
+            }
+        }
+    }
+}
+
+TEST(copia_de_caminho_test, deve_imprimir_como_a_copia_de_nohs)
+{
+    deve_imprimir_como_a_copia_de_nohs<abb_caminho>(7);
+    deve_imprimir_como_a_copia_de_nohs<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_sem_pai>>(11);
+}
+
+TEST(copia_de_caminho_test, nao_deve_alterar_versoes_publicadas)
+{
+    abb_caminho arvore { abb_caminho::balanceamento::rubro_negro };
+    for (int chave : { 50, 42, 65, 13, 52 })
+    {
+        arvore.inclui(chave);
+    }
+
+    const std::string v5 = ufc::eda::io::utils::to_string(arvore, 5);
+    EXPECT_EQ(v5, "13,2,R 42,1,N 50,0,N 52,2,R 65,1,N");
+
+    // Recoloracoes e rotacoes so podem escrever em copias
+    for (int chave : { 14, 15, 16, 17, 18 })
+    {
+        arvore.inclui(chave);
+    }
+    arvore.remove(50);
+    arvore.remove(42);
+
+    EXPECT_EQ(ufc::eda::io::utils::to_string(arvore, 5), v5);
+    EXPECT_EQ(ufc::eda::io::utils::to_string(arvore, 3), "42,1,R 50,0,N 65,1,R");
+}
+
+TEST(copia_de_caminho_test, deve_permitir_leitores_concorrentes_ao_escritor)
+{
+    static_assert(abb_caminho::leitura_concorrente, "copia_de_caminho deve aceitar leitores concorrentes");
+
+    const int total = 20000;
+
+    // A versao v tem exatamente as v primeiras chaves incluidas
+    std::vector<int> chaves(total);
+    std::vector<int64_t> somas(total + 1, 0);
+    std::mt19937 gerador(7);
+    for (int i = 0; i < total; i++)
+    {
+        chaves[i] = i;
+    }
+    std::shuffle(chaves.begin(), chaves.end(), gerador);
+    for (int i = 0; i < total; i++)
+    {
+        somas[i + 1] = somas[i] + chaves[i];
+    }
+
+    abb_caminho arvore(abb_caminho::balanceamento::rubro_negro);
+    std::atomic<bool> terminou { false };
+    std::atomic<int> erros { 0 };
+    std::atomic<int> leituras { 0 };
+
+    std::vector<std::thread> leitores;
+    for (int t = 0; t < 3; t++)
+    {
+        leitores.emplace_back([&]() {
+            while (!terminou.load())
+            {
+                const size_t versao = arvore.ultima_versao();
+
+                int n = 0;
+                int anterior = -1;
+                int64_t soma = 0;
+                arvore.visita_em_ordem(versao, [&](const abb_caminho::noh& x) {
+                    const int k = x.chave(versao);
+                    if (k <= anterior)
+                    {
+                        erros++;
+                    }
+                    anterior = k;
+                    soma += k;
+                    n++;
+                });
+
+                if (static_cast<size_t>(n) != versao || soma != somas[versao])
+                {
+                    erros++;
+                }
+                if (versao > 0 && arvore.busca_sucessor(chaves[versao - 1] - 1, versao) == nullptr)
+                {
+                    erros++;
+                }
+                leituras++;
+            }
+        });
+    }
+
+    for (int k : chaves)
+    {
+        arvore.inclui(k);
+    }
+    terminou = true;
+
+    for (std::thread& t : leitores)
+    {
+        t.join();
+    }
+
+    EXPECT_EQ(erros.load(), 0);
+    EXPECT_GT(leituras.load(), 0);
+    EXPECT_EQ(arvore.ultima_versao(), static_cast<size_t>(total));
+}
+
+TEST(copia_de_caminho_test, deve_achar_a_profundidade_numa_corrente_de_chaves_iguais)
+{
+    // Sem balanceamento, chaves iguais formam uma corrente, e cada uma eh procurada nos
+    // dois lados de cada igual no caminho
+    abb_caminho arvore;
+    for (int i = 0; i < 3000; i++)
+    {
+        arvore.inclui(i % 500 == 0 ? i : 7);
+    }
+
+    const size_t versao = arvore.ultima_versao();
+    size_t visitados = 0;
+    arvore.percorre_em_ordem(versao, [&](const abb_caminho::noh& n, int profundidade) {
+        EXPECT_EQ(arvore.profundidade(versao, n), profundidade);
+        visitados++;
+    });
+    EXPECT_EQ(visitados, 3000u);
+}
@@ -0,0 +1,11 @@
+#include <gtest/gtest.h>
+
+#include "persistencia/abb.h"
+
+using abb_sem_pai = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_sem_pai>;
+
+TEST(copia_de_nohs_sem_pai_test, deve_caber_numa_linha_de_cache)
+{
+    EXPECT_LE(sizeof(abb_sem_pai::noh), 64u);
+    EXPECT_EQ(alignof(abb_sem_pai::noh) % 16, 0u);
+}
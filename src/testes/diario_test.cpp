@@ -0,0 +1,220 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "io/diario.h"
+#include "io/executor.h"
+
+namespace
+{
+
+const std::string arquivo_diario = "teste_diario.bin";
+const std::string arquivo_imagem = "teste_diario_imagem.bin";
+const std::string arquivo_saida = "teste_saida_diario.txt";
+
+std::vector<ufc::eda::io::op> atualizacoes(unsigned semente, int n)
+{
+    std::mt19937 gerador(semente);
+    std::uniform_int_distribution<int> chaves(0, 80);
+
+    std::vector<ufc::eda::io::op> ops;
+    for (int i = 0; i < n; i++)
+    {
+        const auto tipo = gerador() % 3 == 0 ? ufc::eda::io::op::tipo::REMOCAO : ufc::eda::io::op::tipo::INCLUSAO;
+        ops.push_back(ufc::eda::io::op(tipo, chaves(gerador)));
+    }
+
+    return ops;
+}
+
+// Consultas sobre todas as versoes, intercaladas com mais atualizacoes
+std::vector<ufc::eda::io::op> consultas_e_atualizacoes(int versoes)
+{
+    std::vector<ufc::eda::io::op> ops;
+    for (int v = 0; v <= versoes; v++)
+    {
+        ops.push_back(ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, v));
+        ops.push_back(ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, v % 81, v));
+    }
+    for (const ufc::eda::io::op& op : atualizacoes(99, 50))
+    {
+        ops.push_back(op);
+        ops.push_back(ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, versoes + 50));
+    }
+
+    return ops;
+}
+
+std::string executa(ufc::eda::io::executor& executor, const std::vector<ufc::eda::io::op>& ops)
+{
+    for (const ufc::eda::io::op& op : ops)
+    {
+        executor.enfila(op);
+    }
+    executor.executa();
+
+    std::ifstream arquivo(arquivo_saida, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(arquivo), std::istreambuf_iterator<char>());
+}
+
+// Saida das consultas apos todas as atualizacoes, sem diario nem imagem
+std::string saida_esperada(const std::vector<ufc::eda::io::op>& historico)
+{
+    std::vector<ufc::eda::io::op> ops = historico;
+    const std::vector<ufc::eda::io::op> consultas = consultas_e_atualizacoes(static_cast<int>(historico.size()));
+    ops.insert(ops.end(), consultas.begin(), consultas.end());
+
+    ufc::eda::io::executor executor(arquivo_saida, 1);
+    return executa(executor, ops);
+}
+
+void remove_arquivos()
+{
+    std::remove(arquivo_diario.c_str());
+    std::remove(arquivo_imagem.c_str());
+    std::remove(arquivo_saida.c_str());
+}
+
+}
+
+TEST(diario_test, deve_recuperar_as_versoes_pelo_diario)
+{
+    remove_arquivos();
+    const std::vector<ufc::eda::io::op> historico = atualizacoes(3, 400);
+    const std::string esperada = saida_esperada(historico);
+
+    {
+        ufc::eda::io::executor executor(arquivo_saida, 1);
+        ASSERT_TRUE(executor.abre_diario(arquivo_diario, 64));
+        executa(executor, historico);
+        EXPECT_TRUE(executor.fecha_diario());
+    }
+
+    ufc::eda::io::executor executor(arquivo_saida, 1);
+    ASSERT_TRUE(executor.abre_diario(arquivo_diario));
+    EXPECT_EQ(executa(executor, consultas_e_atualizacoes(static_cast<int>(historico.size()))), esperada);
+
+    remove_arquivos();
+}
+
+TEST(diario_test, deve_reaplicar_so_o_que_a_imagem_nao_tem)
+{
+    remove_arquivos();
+    const std::vector<ufc::eda::io::op> historico = atualizacoes(5, 400);
+    const std::vector<ufc::eda::io::op> inicio(historico.begin(), historico.begin() + 150);
+    const std::vector<ufc::eda::io::op> resto(historico.begin() + 150, historico.end());
+    const std::string esperada = saida_esperada(historico);
+
+    {
+        // A imagem esvazia o diario, que depois so registra o resto
+        ufc::eda::io::executor executor(arquivo_saida, 1);
+        ASSERT_TRUE(executor.abre_diario(arquivo_diario));
+        executa(executor, inicio);
+        ASSERT_TRUE(executor.salva_imagem(arquivo_imagem));
+        executa(executor, resto);
+        EXPECT_TRUE(executor.fecha_diario());
+
+        ufc::eda::io::diario d(arquivo_diario, 0);
+        EXPECT_EQ(d.versao_base(), inicio.size());
+        EXPECT_EQ(d.versao_final(), historico.size());
+    }
+
+    ufc::eda::io::executor executor(arquivo_saida, 1);
+    ASSERT_TRUE(executor.carrega_imagem(arquivo_imagem));
+    ASSERT_TRUE(executor.abre_diario(arquivo_diario));
+    EXPECT_EQ(executa(executor, consultas_e_atualizacoes(static_cast<int>(historico.size()))), esperada);
+
+    remove_arquivos();
+}
+
+TEST(diario_test, deve_pular_o_que_a_imagem_ja_tem)
+{
+    // Queda entre gravar a imagem e esvaziar o diario: o inicio do diario ja esta nela
+    remove_arquivos();
+    const std::vector<ufc::eda::io::op> historico = atualizacoes(7, 400);
+    const std::string esperada = saida_esperada(historico);
+
+    {
+        ufc::eda::io::executor executor(arquivo_saida, 1);
+        ASSERT_TRUE(executor.abre_diario(arquivo_diario));
+        executa(executor, historico);
+        EXPECT_TRUE(executor.fecha_diario());
+    }
+    {
+        ufc::eda::io::executor executor(arquivo_saida, 1);
+        executa(executor, std::vector<ufc::eda::io::op>(historico.begin(), historico.begin() + 150));
+        ASSERT_TRUE(executor.salva_imagem(arquivo_imagem));
+    }
+
+    ufc::eda::io::executor executor(arquivo_saida, 1);
+    ASSERT_TRUE(executor.carrega_imagem(arquivo_imagem));
+    ASSERT_TRUE(executor.abre_diario(arquivo_diario));
+    EXPECT_EQ(executa(executor, consultas_e_atualizacoes(static_cast<int>(historico.size()))), esperada);
+
+    remove_arquivos();
+}
+
+TEST(diario_test, deve_descartar_registro_interrompido)
+{
+    remove_arquivos();
+    {
+        ufc::eda::io::diario d(arquivo_diario, 0, 0);
+        ASSERT_TRUE(d.aberto());
+        d.anexa(ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 10));
+        d.anexa(ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 10, 0));
+        d.anexa(ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, -7));
+        EXPECT_EQ(d.versao_final(), 2u);
+    }
+    {
+        // Um registro pela metade, como apos uma queda durante a escrita
+        std::ofstream arquivo(arquivo_diario, std::ios::binary | std::ios::app);
+        arquivo.write("I\x01\x02", 3);
+    }
+    {
+        ufc::eda::io::diario d(arquivo_diario, 0);
+        ASSERT_TRUE(d.aberto());
+        EXPECT_EQ(d.versao_final(), 2u);
+        d.anexa(ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 30));
+    }
+
+    ufc::eda::io::diario d(arquivo_diario, 0);
+    std::vector<ufc::eda::io::op> lidas;
+    ASSERT_TRUE(d.reproduz(1, [&lidas](const ufc::eda::io::op& op) { lidas.push_back(op); }));
+    ASSERT_EQ(lidas.size(), 2u);
+    EXPECT_TRUE(lidas[0] == ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, -7));
+    EXPECT_TRUE(lidas[1] == ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 30));
+
+    EXPECT_FALSE(d.reproduz(4, [](const ufc::eda::io::op&) {}));
+
+    remove_arquivos();
+}
+
+TEST(diario_test, deve_recusar_diario_que_nao_continua_a_arvore)
+{
+    remove_arquivos();
+    {
+        // Diario comecando na versao 5, sem as versoes anteriores
+        ufc::eda::io::diario d(arquivo_diario, 5);
+        d.anexa(ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 1));
+    }
+    {
+        ufc::eda::io::executor executor(arquivo_saida, 1);
+        EXPECT_FALSE(executor.abre_diario(arquivo_diario));
+    }
+    {
+        // Arquivo que nao eh um diario
+        std::ofstream arquivo(arquivo_diario, std::ios::binary | std::ios::trunc);
+        arquivo << "INC 1\nINC 2\nINC 3\nINC 4\nINC 5\nINC 6\n";
+    }
+    {
+        ufc::eda::io::executor executor(arquivo_saida, 1);
+        EXPECT_FALSE(executor.abre_diario(arquivo_diario));
+    }
+
+    remove_arquivos();
+}
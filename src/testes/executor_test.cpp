@@ -1,4 +1,7 @@
+#include <cstdio>
 #include <fstream>
+#include <iterator>
+#include <string>
 
 #include <gtest/gtest.h>
 
@@ -61,5 +64,284 @@ TEST(executor_test, deve_ser_capaz_de_instrumentar_a_partir_de_arquivo)
         executor.enfila(op);
     }
 
-    executor.executa();
+    EXPECT_TRUE(executor.executa());
+}
+
+TEST(executor_test, deve_escrever_a_mesma_saida_em_pipeline)
+{
+    const char* nome_arquivo_entrada = "teste_entrada_pipeline.txt";
+    const char* nome_arquivo_sequencial = "teste_saida_sequencial.txt";
+    const char* nome_arquivo_pipeline = "teste_saida_pipeline.txt";
+
+    // Varios lotes, com consultas espalhadas entre as atualizacoes
+    {
+        std::ofstream arquivo(nome_arquivo_entrada);
+        arquivo << conteudo_arquivo_entrada;
+        for (int i = 0; i < 20000; i++)
+        {
+            arquivo << (i % 3 == 2 ? "REM " : "INC ") << (i * 7919) % 1000 << "\n";
+            if (i % 97 == 0)
+            {
+                arquivo << "SUC " << i % 1000 << " " << i / 2 << "\n";
+            }
+            if (i % 1999 == 0)
+            {
+                arquivo << "IMP " << i << "\n";
+            }
+        }
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada);
+        ASSERT_TRUE(fparser.parse());
+
+        ufc::eda::io::executor executor(nome_arquivo_sequencial);
+        for (const ufc::eda::io::op& op : fparser.operacoes())
+        {
+            executor.enfila(op);
+        }
+        executor.executa();
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada, ufc::eda::io::file_parser::leitura::mapeada);
+        ufc::eda::io::executor executor(nome_arquivo_pipeline);
+        ASSERT_TRUE(executor.executa_em_pipeline(fparser));
+    }
+
+    std::ifstream sequencial(nome_arquivo_sequencial);
+    std::ifstream pipeline(nome_arquivo_pipeline);
+    const std::string conteudo_sequencial((std::istreambuf_iterator<char>(sequencial)), std::istreambuf_iterator<char>());
+    const std::string conteudo_pipeline((std::istreambuf_iterator<char>(pipeline)), std::istreambuf_iterator<char>());
+
+    EXPECT_FALSE(conteudo_sequencial.empty());
+    EXPECT_EQ(conteudo_pipeline, conteudo_sequencial);
+
+    std::remove(nome_arquivo_entrada);
+    std::remove(nome_arquivo_sequencial);
+    std::remove(nome_arquivo_pipeline);
+}
+
+TEST(executor_test, pipeline_deve_falhar_sem_arquivo_de_entrada)
+{
+    ufc::eda::io::file_parser fparser("nao_existe.txt", ufc::eda::io::file_parser::leitura::mapeada);
+    ufc::eda::io::executor executor("nao_deve_ser_criado.txt");
+
+    EXPECT_FALSE(executor.executa_em_pipeline(fparser));
+    EXPECT_FALSE(std::ifstream("nao_deve_ser_criado.txt").is_open());
+}
+
+#ifdef __linux__
+TEST(executor_test, deve_acusar_falha_na_gravacao_da_saida)
+{
+    const char* nome_arquivo_entrada = "teste_entrada_executor_saida_cheia.txt";
+    gera_arquivo_entrada_execucao(nome_arquivo_entrada);
+
+    // Escritas em /dev/full falham com ENOSPC, como num disco cheio
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada, ufc::eda::io::file_parser::leitura::mapeada);
+        ufc::eda::io::executor executor("/dev/full");
+
+        EXPECT_TRUE(executor.executa_em_pipeline(fparser));
+        EXPECT_FALSE(executor.saida_gravada());
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada);
+        ufc::eda::io::executor executor("/dev/full");
+        fparser.parse([&executor](const ufc::eda::io::op& op) { executor.executa(op); });
+
+        EXPECT_FALSE(executor.conclui());
+        EXPECT_FALSE(executor.saida_gravada());
+    }
+
+    std::remove(nome_arquivo_entrada);
+}
+#endif
+
+TEST(executor_test, deve_escrever_a_mesma_saida_em_fluxo)
+{
+    const char* nome_arquivo_entrada = "teste_entrada_fluxo.txt";
+    const char* nome_arquivo_enfilado = "teste_saida_enfilado.txt";
+    const char* nome_arquivo_fluxo = "teste_saida_fluxo.txt";
+
+    gera_arquivo_entrada_execucao(nome_arquivo_entrada);
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada);
+        ASSERT_TRUE(fparser.parse());
+
+        ufc::eda::io::executor executor(nome_arquivo_enfilado);
+        for (const ufc::eda::io::op& op : fparser.operacoes())
+        {
+            executor.enfila(op);
+        }
+        executor.executa();
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada, ufc::eda::io::file_parser::leitura::mapeada);
+        ufc::eda::io::executor executor(nome_arquivo_fluxo);
+        ASSERT_TRUE(fparser.parse([&executor](const ufc::eda::io::op& op) { executor.executa(op); }));
+
+        // Nada guardado: a entrada passou direto para o executor
+        EXPECT_TRUE(fparser.operacoes().empty());
+        executor.conclui();
+    }
+
+    std::ifstream enfilado(nome_arquivo_enfilado);
+    std::ifstream fluxo(nome_arquivo_fluxo);
+    const std::string conteudo_enfilado((std::istreambuf_iterator<char>(enfilado)), std::istreambuf_iterator<char>());
+    const std::string conteudo_fluxo((std::istreambuf_iterator<char>(fluxo)), std::istreambuf_iterator<char>());
+
+    EXPECT_FALSE(conteudo_enfilado.empty());
+    EXPECT_EQ(conteudo_fluxo, conteudo_enfilado);
+
+    std::remove(nome_arquivo_entrada);
+    std::remove(nome_arquivo_enfilado);
+    std::remove(nome_arquivo_fluxo);
+}
+
+TEST(executor_test, deve_responder_consultas_em_paralelo_na_ordem_da_entrada)
+{
+    const char* nome_arquivo_entrada = "teste_entrada_consultas.txt";
+    const char* nomes_arquivos_saida[] = { "teste_saida_uma_thread.txt", "teste_saida_fluxo_paralelo.txt",
+                                           "teste_saida_pipeline_paralelo.txt" };
+
+    // Rajadas longas de consultas entre poucas atualizacoes
+    {
+        std::ofstream arquivo(nome_arquivo_entrada);
+        for (int i = 0; i < 300; i++)
+        {
+            arquivo << "INC " << (i * 37) % 101 << "\n";
+            if (i % 50 == 49)
+            {
+                for (int j = 0; j < 3000; j++)
+                {
+                    if (j % 500 == 0)
+                    {
+                        arquivo << "IMP " << j % (i + 1) << "\n";
+                    }
+                    arquivo << "SUC " << j % 103 << " " << j % (i + 2) << "\n";
+                }
+            }
+        }
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada);
+        ufc::eda::io::executor executor(nomes_arquivos_saida[0], 1);
+        ASSERT_TRUE(fparser.parse([&executor](const ufc::eda::io::op& op) { executor.executa(op); }));
+        executor.conclui();
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada);
+        ufc::eda::io::executor executor(nomes_arquivos_saida[1], 4);
+        ASSERT_TRUE(fparser.parse([&executor](const ufc::eda::io::op& op) { executor.executa(op); }));
+        executor.conclui();
+    }
+
+    {
+        ufc::eda::io::file_parser fparser(nome_arquivo_entrada, ufc::eda::io::file_parser::leitura::mapeada);
+        ufc::eda::io::executor executor(nomes_arquivos_saida[2], 4);
+        ASSERT_TRUE(executor.executa_em_pipeline(fparser));
+    }
+
+    std::string conteudos[3];
+    for (int i = 0; i < 3; i++)
+    {
+        std::ifstream arquivo(nomes_arquivos_saida[i]);
+        conteudos[i].assign((std::istreambuf_iterator<char>(arquivo)), std::istreambuf_iterator<char>());
+        std::remove(nomes_arquivos_saida[i]);
+    }
+    std::remove(nome_arquivo_entrada);
+
+    EXPECT_FALSE(conteudos[0].empty());
+    EXPECT_EQ(conteudos[1], conteudos[0]);
+    EXPECT_EQ(conteudos[2], conteudos[0]);
+}
+
+TEST(executor_test, deve_salvar_os_custos_em_json)
+{
+    const char* nome_arquivo_saida = "teste_saida_custos.txt";
+    const char* nome_arquivo_custos = "teste_custos.json";
+
+    ufc::eda::io::executor executor(nome_arquivo_saida);
+    for (int i = 0; i < 100; i++)
+    {
+        executor.executa(ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, i));
+    }
+    executor.conclui();
+    ASSERT_TRUE(executor.salva_custos(nome_arquivo_custos));
+
+    std::ifstream arquivo(nome_arquivo_custos);
+    const std::string json((std::istreambuf_iterator<char>(arquivo)), std::istreambuf_iterator<char>());
+
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_NE(json.find("\"ultima_versao\": 100,"), std::string::npos);
+    EXPECT_NE(json.find("\"nohs_vivos\": "), std::string::npos);
+    EXPECT_NE(json.find("\"acumulado\": { \"nohs_criados\": "), std::string::npos);
+    EXPECT_NE(json.find("\"maximo_por_versao\""), std::string::npos);
+    EXPECT_NE(json.find("\"versao_com_mais_copias\""), std::string::npos);
+
+    EXPECT_FALSE(executor.salva_custos("diretorio_inexistente/custos.json"));
+
+    std::remove(nome_arquivo_saida);
+    std::remove(nome_arquivo_custos);
+}
+
+TEST(executor_test, deve_coletar_estatisticas_da_execucao)
+{
+    const char* nome_arquivo_saida = "teste_saida_estatisticas.txt";
+    const char* nome_arquivo_estatisticas = "teste_estatisticas.json";
+
+    for (size_t threads : { size_t(1), size_t(4) })
+    {
+        ufc::eda::io::executor executor(nome_arquivo_saida, threads);
+        EXPECT_EQ(executor.estatisticas_coletadas(), nullptr);
+        EXPECT_FALSE(executor.salva_estatisticas(nome_arquivo_estatisticas));
+
+        executor.coleta_estatisticas();
+        for (int i = 0; i < 100; i++)
+        {
+            executor.executa(ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, i));
+            executor.executa(ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, i, i + 1));
+        }
+        executor.executa(ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 0));
+        executor.executa(ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 2));
+        executor.executa(ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 3));
+        executor.conclui();
+
+        const ufc::eda::io::estatisticas& e = *executor.estatisticas_coletadas();
+        EXPECT_EQ(e.quantidade(ufc::eda::io::op::tipo::INCLUSAO), 100u);
+        EXPECT_EQ(e.quantidade(ufc::eda::io::op::tipo::REMOCAO), 1u);
+        EXPECT_EQ(e.quantidade(ufc::eda::io::op::tipo::SUCESSAO), 100u);
+        EXPECT_EQ(e.quantidade(ufc::eda::io::op::tipo::IMPRESSAO), 2u);
+
+        // As duas IMPs, com o eco de cada uma, sao o final da saida
+        std::ifstream saida(nome_arquivo_saida);
+        const std::string texto((std::istreambuf_iterator<char>(saida)), std::istreambuf_iterator<char>());
+        const size_t imp = texto.find("IMP 2");
+        ASSERT_NE(imp, std::string::npos);
+        EXPECT_EQ(e.bytes_de_impressao(), texto.size() - imp);
+
+        uint64_t concluidas = 0;
+        for (uint64_t n : e.operacoes_por_janela())
+        {
+            concluidas += n;
+        }
+        EXPECT_EQ(concluidas, 203u);
+
+        ASSERT_TRUE(executor.salva_estatisticas(nome_arquivo_estatisticas));
+        std::ifstream arquivo(nome_arquivo_estatisticas);
+        const std::string json((std::istreambuf_iterator<char>(arquivo)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(json.front(), '{');
+        EXPECT_NE(json.find("\"INC\": { \"quantidade\": 100, "), std::string::npos);
+        EXPECT_NE(json.find("\"IMP\": { \"quantidade\": 2, "), std::string::npos);
+        EXPECT_NE(json.find("\"operacoes_por_janela\": ["), std::string::npos);
+    }
+
+    std::remove(nome_arquivo_saida);
+    std::remove(nome_arquivo_estatisticas);
 }
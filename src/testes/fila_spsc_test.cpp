@@ -0,0 +1,58 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "io/fila_spsc.h"
+
+TEST(fila_spsc_test, deve_respeitar_a_capacidade)
+{
+    ufc::eda::io::fila_spsc<int> fila(3);
+
+    // Capacidade arredondada para a potencia de 2 seguinte
+    for (int i = 0; i < 4; i++)
+    {
+        int valor = i;
+        EXPECT_TRUE(fila.tenta_enfilar(valor));
+    }
+
+    int extra = 4;
+    EXPECT_FALSE(fila.tenta_enfilar(extra));
+
+    int valor = -1;
+    EXPECT_TRUE(fila.tenta_desenfilar(valor));
+    EXPECT_EQ(valor, 0);
+    EXPECT_TRUE(fila.tenta_enfilar(extra));
+}
+
+TEST(fila_spsc_test, deve_entregar_tudo_em_ordem_entre_threads)
+{
+    const int total = 200000;
+    ufc::eda::io::fila_spsc<std::vector<int>> fila(8);
+
+    std::thread produtor([&fila, total]() {
+        for (int i = 0; i < total; i += 100)
+        {
+            std::vector<int> lote;
+            for (int j = i; j < i + 100; j++)
+            {
+                lote.push_back(j);
+            }
+            fila.enfila(std::move(lote));
+        }
+        fila.encerra();
+    });
+
+    int esperado = 0;
+    std::vector<int> lote;
+    while (fila.desenfila(lote))
+    {
+        for (int valor : lote)
+        {
+            ASSERT_EQ(valor, esperado++);
+        }
+    }
+    produtor.join();
+
+    EXPECT_EQ(esperado, total);
+}
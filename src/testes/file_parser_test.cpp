@@ -59,3 +59,29 @@ TEST(file_parser_test, deve_ser_capaz_de_ler_arquivo)
         EXPECT_EQ(operacoesObtidas[i], operacoesEsperadas[i]);
     }
 }
+
+TEST(file_parser_test, deve_ler_arquivo_mapeado_com_as_mesmas_regras)
+{
+    // Inclui quebras \r\n, sinais, lixo apos o numero e ultima linha sem quebra
+    const char* nome_arquivo = "teste_leitura_mapeada.txt";
+    {
+        std::ofstream arquivo(nome_arquivo, std::ios::binary);
+        arquivo << conteudo_arquivo << "INC -7\r\nSUC  5\r\nREM +3x\nINC 2147483647\nIMP 9";
+    }
+
+    ufc::eda::io::file_parser por_linhas(nome_arquivo);
+    ufc::eda::io::file_parser mapeado(nome_arquivo, ufc::eda::io::file_parser::leitura::mapeada);
+    ASSERT_TRUE(por_linhas.parse());
+    ASSERT_TRUE(mapeado.parse());
+
+    EXPECT_EQ(mapeado.operacoes(), por_linhas.operacoes());
+    ASSERT_EQ(mapeado.operacoes().size(), 11u);
+    EXPECT_EQ(mapeado.operacoes()[6], ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, -7));
+    EXPECT_EQ(mapeado.operacoes()[7], ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 0, 5));
+    EXPECT_EQ(mapeado.operacoes()[8], ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 3));
+    EXPECT_EQ(mapeado.operacoes()[9], ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 2147483647));
+    EXPECT_EQ(mapeado.operacoes()[10], ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 9));
+
+    ufc::eda::io::file_parser inexistente("nao_existe.txt", ufc::eda::io::file_parser::leitura::mapeada);
+    EXPECT_FALSE(inexistente.parse());
+}
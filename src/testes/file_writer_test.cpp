@@ -1,3 +1,5 @@
+#include <climits>
+#include <cstdio>
 #include <string>
 
 #include <gtest/gtest.h>
@@ -31,14 +33,75 @@ std::string le_conteudo_arquivo(const std::string& nome_arquivo)
 TEST(file_writer_test, deve_ser_capaz_de_ler_arquivo)
 {
     const char* nome_arquivo = "teste_escrita.txt";
-    ufc::eda::io::file_writer fwriter(nome_arquivo);
 
-    fwriter << ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 11)
-            << ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 42)
-            << ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 42)
-            << ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 50, 65)
-            << ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 65)
-            << ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 20);
+    // A saida so chega ao arquivo quando o escritor eh fechado
+    {
+        ufc::eda::io::file_writer fwriter(nome_arquivo);
+
+        fwriter << ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 11)
+                << ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 42)
+                << ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 42)
+                << ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 50, 65)
+                << ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 65)
+                << ufc::eda::io::op(ufc::eda::io::op::tipo::IMPRESSAO, 20);
+    }
 
     EXPECT_STREQ(le_conteudo_arquivo(nome_arquivo).c_str(), conteudo_esperado);
 }
+
+TEST(file_writer_test, deve_escrever_os_mesmos_bytes_nos_dois_modos)
+{
+    const char* nomes_arquivos[] = { "teste_escrita_fluxo.txt", "teste_escrita_direta.txt" };
+    const ufc::eda::io::file_writer::saida modos[] = {
+        ufc::eda::io::file_writer::saida::fluxo,
+        ufc::eda::io::file_writer::saida::direta
+    };
+
+    // Maior que o buffer, para passar tambem pelo caminho que escreve sem copiar
+    const std::string longa(ufc::eda::io::file_writer::capacidade_buffer + 7, 'x');
+
+    std::string esperado = "SUC -7 3\n";
+    esperado += std::to_string(INT_MIN) + " " + std::to_string(INT_MAX) + " 0,1,R\n";
+    esperado += longa + "\nINF\n";
+
+    for (int i = 0; i < 2; i++)
+    {
+        {
+            ufc::eda::io::file_writer fwriter(nomes_arquivos[i], modos[i]);
+
+            fwriter << ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, -7, 3)
+                    << INT_MIN << ' ' << INT_MAX << " " << 0 << ',' << 1 << std::string(",R") << "\n"
+                    << longa << std::string("\r\n") << "INF" << '\n';
+        }
+
+        EXPECT_EQ(le_conteudo_arquivo(nomes_arquivos[i]), esperado);
+        std::remove(nomes_arquivos[i]);
+    }
+}
+
+#ifdef __linux__
+TEST(file_writer_test, flush_deve_falhar_quando_a_escrita_falha)
+{
+    const ufc::eda::io::file_writer::saida modos[] = {
+        ufc::eda::io::file_writer::saida::fluxo,
+        ufc::eda::io::file_writer::saida::direta
+    };
+
+    // Escritas em /dev/full falham com ENOSPC, como num disco cheio
+    for (ufc::eda::io::file_writer::saida modo : modos)
+    {
+        ufc::eda::io::file_writer fwriter("/dev/full", modo);
+        fwriter << ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 11);
+
+        EXPECT_FALSE(fwriter.flush());
+
+        // A falha fica registrada, mesmo sem nada novo a escrever
+        EXPECT_FALSE(fwriter.flush());
+    }
+
+    ufc::eda::io::file_writer fwriter("teste_escrita_flush.txt", ufc::eda::io::file_writer::saida::direta);
+    fwriter << ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 11);
+    EXPECT_TRUE(fwriter.flush());
+    std::remove("teste_escrita_flush.txt");
+}
+#endif
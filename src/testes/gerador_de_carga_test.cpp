@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "io/gerador_de_carga.h"
+#include "persistencia/abb.h"
+
+namespace
+{
+
+std::vector<ufc::eda::io::op> gera(const ufc::eda::io::gerador_de_carga::parametros& p, size_t n)
+{
+    ufc::eda::io::gerador_de_carga gerador(p);
+
+    std::vector<ufc::eda::io::op> ops;
+    for (size_t i = 0; i < n; i++)
+    {
+        ops.push_back(gerador.proxima());
+    }
+
+    return ops;
+}
+
+}
+
+TEST(gerador_de_carga_test, deve_gerar_a_mesma_sequencia_para_a_mesma_semente)
+{
+    using distribuicao = ufc::eda::io::gerador_de_carga::distribuicao;
+
+    for (distribuicao d : { distribuicao::uniforme, distribuicao::zipf, distribuicao::monotonica, distribuicao::adversaria })
+    {
+        ufc::eda::io::gerador_de_carga::parametros p;
+        p.chaves = d;
+        p.impressao_a_cada = 100;
+        p.semente = 7;
+
+        const std::vector<ufc::eda::io::op> a = gera(p, 5000);
+        EXPECT_TRUE(a == gera(p, 5000));
+
+        p.semente = 8;
+        EXPECT_FALSE(a == gera(p, 5000));
+    }
+
+    // A sequencia nao depende da plataforma: as primeiras operacoes da semente 1 sao fixas
+    const std::vector<ufc::eda::io::op> esperadas {
+        ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 890590),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 968761, 0),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 60533, 1),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 703870)
+    };
+    EXPECT_TRUE(gera(ufc::eda::io::gerador_de_carga::parametros(), 4) == esperadas);
+}
+
+TEST(gerador_de_carga_test, deve_gerar_zipf_e_vies_das_versoes_fixos_para_a_mesma_semente)
+{
+    // Zipf e o vies das versoes usam ponto fixo, e nao <cmath>: as sequencias tambem sao fixas
+    ufc::eda::io::gerador_de_carga::parametros zipf;
+    zipf.chaves = ufc::eda::io::gerador_de_carga::distribuicao::zipf;
+    zipf.expoente_zipf = 1.2;
+    zipf.percentual_de_leituras = 0;
+
+    const std::vector<ufc::eda::io::op> esperadas_zipf {
+        ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 0),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 618033),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 941016),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 90165),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 832792),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::INCLUSAO, 0)
+    };
+    EXPECT_TRUE(gera(zipf, 6) == esperadas_zipf);
+
+    ufc::eda::io::gerador_de_carga::parametros vies;
+    vies.vies_das_versoes = 4.0;
+
+    const std::vector<ufc::eda::io::op> ops = gera(vies, 1000);
+    const std::vector<ufc::eda::io::op> esperadas_vies {
+        ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 506291, 449),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 123307, 304),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 124725, 292),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 904906),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::REMOCAO, 590699),
+        ufc::eda::io::op(ufc::eda::io::op::tipo::SUCESSAO, 314209, 502)
+    };
+    EXPECT_TRUE(std::vector<ufc::eda::io::op>(ops.end() - 6, ops.end()) == esperadas_vies);
+}
+
+TEST(gerador_de_carga_test, deve_respeitar_as_proporcoes_e_as_versoes)
+{
+    ufc::eda::io::gerador_de_carga::parametros p;
+    p.percentual_de_leituras = 30;
+    p.percentual_de_remocoes = 25;
+    p.impressao_a_cada = 1000;
+    p.chaves = ufc::eda::io::gerador_de_carga::distribuicao::zipf;
+    p.intervalo = 5000;
+    p.vies_das_versoes = 8.0;
+
+    size_t por_tipo[4] = {};
+    size_t versao = 0;
+    size_t versoes_recentes = 0;
+    for (const ufc::eda::io::op& op : gera(p, 100000))
+    {
+        por_tipo[static_cast<int>(op.tipoOperacao)]++;
+
+        if (op.tipoOperacao == ufc::eda::io::op::tipo::INCLUSAO || op.tipoOperacao == ufc::eda::io::op::tipo::REMOCAO)
+        {
+            EXPECT_GE(op.lparam, 0);
+            EXPECT_LT(op.lparam, 5000);
+            versao++;
+        }
+        else
+        {
+            // Versao consultada: a de IMP no primeiro parametro, a de SUC no segundo
+            const int v = op.tipoOperacao == ufc::eda::io::op::tipo::IMPRESSAO ? op.lparam : op.rparam;
+            EXPECT_GE(v, 0);
+            EXPECT_LE(static_cast<size_t>(v), versao);
+            versoes_recentes += versao - static_cast<size_t>(v) <= versao / 10 ? 1 : 0;
+        }
+    }
+
+    EXPECT_EQ(por_tipo[3], 100u);
+    EXPECT_NEAR(static_cast<double>(por_tipo[2]) / 99900, 0.30, 0.01);
+    EXPECT_NEAR(static_cast<double>(por_tipo[1]) / (por_tipo[0] + por_tipo[1]), 0.25, 0.01);
+
+    // Com vies, a maioria das consultas cai nos 10% mais recentes das versoes
+    EXPECT_GT(versoes_recentes, (por_tipo[2] + por_tipo[3]) * 3 / 4);
+}
+
+TEST(gerador_de_carga_test, deve_concentrar_as_chaves_de_zipf)
+{
+    ufc::eda::io::gerador_de_carga::parametros p;
+    p.percentual_de_leituras = 0;
+    p.percentual_de_remocoes = 0;
+    p.chaves = ufc::eda::io::gerador_de_carga::distribuicao::zipf;
+    p.intervalo = 100000;
+
+    std::vector<size_t> contagem(p.intervalo);
+    size_t maior = 0;
+    for (const ufc::eda::io::op& op : gera(p, 100000))
+    {
+        maior = std::max(maior, ++contagem[static_cast<size_t>(op.lparam)]);
+    }
+
+    // Com expoente 1, a chave mais popular sai em torno de 1/H(n) ~ 8% das vezes
+    EXPECT_GT(maior, 5000u);
+    EXPECT_LT(maior, 12000u);
+}
+
+TEST(gerador_de_carga_test, deve_degenerar_a_arvore_sem_balanceamento)
+{
+    ufc::eda::io::gerador_de_carga::parametros p;
+    p.percentual_de_leituras = 0;
+    p.percentual_de_remocoes = 0;
+    p.chaves = ufc::eda::io::gerador_de_carga::distribuicao::adversaria;
+
+    ufc::eda::persistencia::abb arvore;
+    for (const ufc::eda::io::op& op : gera(p, 500))
+    {
+        arvore.inclui(op.lparam);
+    }
+
+    int profundidade_maxima = 0;
+    arvore.percorre_em_ordem(arvore.ultima_versao(), [&profundidade_maxima](const ufc::eda::persistencia::abb::noh&, int profundidade) {
+        profundidade_maxima = std::max(profundidade_maxima, profundidade);
+    });
+    EXPECT_EQ(profundidade_maxima, 499);
+}
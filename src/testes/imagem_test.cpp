@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "io/imagem.h"
+#include "io/utils.h"
+#include "persistencia/abb.h"
+
+namespace
+{
+
+const std::string arquivo_imagem = "teste_imagem.bin";
+
+template <typename abb>
+void aplica_aleatorias(abb& arvore, abb* outra, unsigned semente, int n)
+{
+    std::mt19937 gerador(semente);
+    std::uniform_int_distribution<int> chaves(0, 60);
+    for (int i = 0; i < n; i++)
+    {
+        const int chave = chaves(gerador);
+        const bool remove = gerador() % 3 == 0;
+        for (abb* a : { &arvore, outra })
+        {
+            if (a == nullptr)
+            {
+                continue;
+            }
+
+            if (remove)
+            {
+                a->remove(chave);
+            }
+            else
+            {
+                a->inclui(chave);
+            }
+        }
+    }
+}
+
+template <typename abb>
+void compara_todas_as_versoes(const abb& esperada, const abb& obtida)
+{
+    ASSERT_EQ(esperada.ultima_versao(), obtida.ultima_versao());
+    for (size_t versao = 0; versao <= esperada.ultima_versao(); versao++)
+    {
+        EXPECT_EQ(ufc::eda::io::utils::to_string(esperada, versao), ufc::eda::io::utils::to_string(obtida, versao));
+        for (int x = -1; x <= 61; x += 4)
+        {
+            EXPECT_EQ(esperada.sucessor(x, versao), obtida.sucessor(x, versao));
+        }
+    }
+}
+
+std::string conteudo(const std::string& nome_arquivo)
+{
+    std::ifstream arquivo(nome_arquivo, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(arquivo), std::istreambuf_iterator<char>());
+}
+
+template <typename abb>
+void deve_recuperar_todas_as_versoes()
+{
+    for (auto b : { abb::balanceamento::nenhum, abb::balanceamento::rubro_negro })
+    {
+        abb original { b };
+        aplica_aleatorias<abb>(original, nullptr, 5, 1500);
+        ASSERT_TRUE(ufc::eda::io::salva_imagem(original, arquivo_imagem));
+        const std::string gravado = conteudo(arquivo_imagem);
+
+        {
+            abb carregada { b };
+            ASSERT_TRUE(ufc::eda::io::carrega_imagem(carregada, arquivo_imagem));
+            compara_todas_as_versoes(original, carregada);
+
+            // Novas versoes sobre a imagem, inclusive com escritas em nohs mapeados
+            aplica_aleatorias(original, &carregada, 7, 1500);
+            compara_todas_as_versoes(original, carregada);
+        }
+
+        // As escritas ficaram na memoria do processo, o arquivo nao mudou
+        EXPECT_EQ(conteudo(arquivo_imagem), gravado);
+    }
+
+    std::remove(arquivo_imagem.c_str());
+}
+
+}
+
+TEST(imagem_test, deve_recuperar_todas_as_versoes_de_cada_motor)
+{
+    deve_recuperar_todas_as_versoes<ufc::eda::persistencia::abb>();
+    deve_recuperar_todas_as_versoes<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_caminho>>();
+    deve_recuperar_todas_as_versoes<ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_nohs_sem_pai>>();
+}
+
+TEST(imagem_test, deve_recuperar_arvore_compactada)
+{
+    using ufc::eda::persistencia::abb;
+
+    abb original { abb::balanceamento::rubro_negro };
+    abb completa { abb::balanceamento::rubro_negro };
+    original.retem_a_partir_da_versao(1000);
+    aplica_aleatorias<abb>(original, &completa, 11, 1500);
+    original.compacta();
+    ASSERT_LT(original.total_nohs(), completa.total_nohs());
+    ASSERT_TRUE(ufc::eda::io::salva_imagem(original, arquivo_imagem));
+
+    // As versoes expiradas sao gravadas como a primeira retida
+    abb carregada { abb::balanceamento::rubro_negro };
+    ASSERT_TRUE(ufc::eda::io::carrega_imagem(carregada, arquivo_imagem));
+    compara_todas_as_versoes(original, carregada);
+    for (size_t versao = 1000; versao <= completa.ultima_versao(); versao++)
+    {
+        EXPECT_EQ(ufc::eda::io::utils::to_string(completa, versao), ufc::eda::io::utils::to_string(carregada, versao));
+    }
+
+    std::remove(arquivo_imagem.c_str());
+}
+
+TEST(imagem_test, deve_recusar_imagem_incompativel)
+{
+    using ufc::eda::persistencia::abb;
+    using abb_caminho = ufc::eda::persistencia::abb_persistente<ufc::eda::persistencia::copia_de_caminho>;
+
+    abb original { abb::balanceamento::rubro_negro };
+    original.inclui(1);
+    original.inclui(2);
+    ASSERT_TRUE(ufc::eda::io::salva_imagem(original, arquivo_imagem));
+
+    {
+        // Outro balanceamento
+        abb arvore { abb::balanceamento::nenhum };
+        EXPECT_FALSE(ufc::eda::io::carrega_imagem(arvore, arquivo_imagem));
+    }
+    {
+        // Outro motor
+        abb_caminho arvore { abb_caminho::balanceamento::rubro_negro };
+        EXPECT_FALSE(ufc::eda::io::carrega_imagem(arvore, arquivo_imagem));
+    }
+    {
+        // Arvore que ja tem versoes
+        abb arvore { abb::balanceamento::rubro_negro };
+        arvore.inclui(3);
+        EXPECT_FALSE(ufc::eda::io::carrega_imagem(arvore, arquivo_imagem));
+    }
+    const std::string gravado = conteudo(arquivo_imagem);
+    {
+        // Raiz da ultima versao fora da arena de nohs
+        ufc::eda::io::imagem::cabecalho c;
+        std::memcpy(&c, gravado.data(), sizeof(c));
+
+        std::string danificado = gravado;
+        const abb::indice fora = static_cast<abb::indice>(c.n_nohs);
+        std::memcpy(&danificado[c.inicio_raizes + (c.n_versoes - 1) * sizeof(abb::indice)], &fora, sizeof(fora));
+        {
+            std::ofstream arquivo(arquivo_imagem, std::ios::binary | std::ios::trunc);
+            arquivo.write(danificado.data(), static_cast<std::streamsize>(danificado.size()));
+        }
+
+        abb arvore { abb::balanceamento::rubro_negro };
+        EXPECT_FALSE(ufc::eda::io::carrega_imagem(arvore, arquivo_imagem));
+    }
+    {
+        // Arquivo truncado
+        {
+            std::ofstream truncado(arquivo_imagem, std::ios::binary | std::ios::trunc);
+            truncado.write(gravado.data(), static_cast<std::streamsize>(gravado.size() - 1));
+        }
+
+        abb arvore { abb::balanceamento::rubro_negro };
+        EXPECT_FALSE(ufc::eda::io::carrega_imagem(arvore, arquivo_imagem));
+    }
+    {
+        // Arquivo inexistente
+        abb arvore { abb::balanceamento::rubro_negro };
+        EXPECT_FALSE(ufc::eda::io::carrega_imagem(arvore, "nao_existe.bin"));
+    }
+
+    std::remove(arquivo_imagem.c_str());
+}
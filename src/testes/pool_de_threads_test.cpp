@@ -0,0 +1,46 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "io/pool_de_threads.h"
+
+TEST(pool_de_threads_test, deve_executar_cada_indice_uma_vez)
+{
+    ufc::eda::io::pool_de_threads pool(4);
+
+    for (size_t n : { 0, 1, 3, 1000 })
+    {
+        std::vector<std::atomic<int>> execucoes(n);
+        for (std::atomic<int>& e : execucoes)
+        {
+            e = 0;
+        }
+
+        pool.para_cada(n, [&execucoes](size_t i) { execucoes[i]++; });
+
+        for (size_t i = 0; i < n; i++)
+        {
+            EXPECT_EQ(execucoes[i].load(), 1);
+        }
+    }
+}
+
+TEST(pool_de_threads_test, deve_equilibrar_tarefas_desiguais)
+{
+    ufc::eda::io::pool_de_threads pool(4);
+
+    // Todo o custo na faixa inicial da primeira thread: as demais precisam roubar
+    std::atomic<size_t> total { 0 };
+    pool.para_cada(64, [&total](size_t i) {
+        if (i < 16)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        total += i;
+    });
+
+    EXPECT_EQ(total.load(), 64u * 63u / 2u);
+}